@@ -1,5 +1,5 @@
 #ifndef _XOPEN_SOURCE
-#define _XOPEN_SOURCE 500
+#define _XOPEN_SOURCE 700
 #endif
 
 #include <stdlib.h>
@@ -13,8 +13,46 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "cbonsai.h"
+
+// options without a short equivalent
+enum longOption {
+	optMaxSteps = 256,
+	optMaxBranches,
+	optTimeLimit,
+	optAmbient,
+	optMaxWakeups,
+	optGeometry,
+	optPregen,
+	optNext,
+	optServe,
+	optFanout,
+	optFormat,
+	optPalette,
+	optLeafFile,
+	optThreads,
+	optExportScene,
+	optLoadScene,
+	optKeepGrowing,
+	optGrowLife,
+	optGrowSteps,
+};
 
-enum branchType {trunk, shootLeft, shootRight, dying, dead};
+enum outputFormat {formatAnsi, formatHtml, formatSvg};
 
 struct config {
 	int live;
@@ -30,14 +68,43 @@ struct config {
 	int save;
 	int load;
 	int targetBranchCount;
+	int maxSteps;
+	int maxBranches;
+	int ambientFps;
+	int maxWakeups;
+	int geometryRows;
+	int geometryCols;
+	int pregenCount;
+	int threads;
+	int growLife;
+	int growSteps;
+	enum outputFormat format;
+	struct cbonsaiPalette palette;
 
 	double timeWait;
 	double timeStep;
+	double timeLimit;
 
 	char* message;
-	char* leaves[64];
 	char* saveFile;
 	char* loadFile;
+	char* pregenFile;
+	char* nextFile;
+	char* serveSocket;
+	char* fanoutTargets;
+	char* exportFile;
+	char* sceneFile;
+	char* growthFile;
+
+	// leaves, from --leaf and --leaf-file, pointing into leafList and leafText
+	const char** leaves;
+	double* leafWeights;
+	int leavesCapacity;
+	char* leafList;
+	char* leafFile;
+	char* leafText;
+	struct cbonsaiLeafSet leafSet;
+	struct cbonsaiArena leafArena;
 };
 
 struct ncursesObjects {
@@ -50,12 +117,52 @@ struct ncursesObjects {
 	PANEL* treePanel;
 	PANEL* messageBorderPanel;
 	PANEL* messagePanel;
+
+	// the palette, resolved to curses attributes
+	attr_t attrs[CBONSAI_ATTRS];
+};
+
+// the leaves still visible in the tree window, so ambient animation can
+// touch only them instead of rescanning the window
+struct leafIndex {
+	struct cbonsaiCanvas canvas;	// the tree window, painted from the scene
+	size_t canvasSize;
+
+	int* cells;		// offsets of the leaves in the canvas
+	unsigned char* lit;	// whether each leaf is currently highlighted
+	size_t count;
+	size_t capacity;
+};
+
+// everything painted while growing the current tree, kept so the tree can be
+// repainted from memory (e.g. when the terminal is resized)
+struct scene {
+	struct cbonsaiArena arena;
+	struct cbonsaiScene paints;
+
+	struct leafIndex leaves;
 };
 
 struct counters {
-	int branches;
-	int shoots;
-	int shootCounter;
+	struct cbonsaiTree tree;
+
+	// screen scheduling, over the whole run
+	int wakeups;
+	struct timespec runStart;
+	double sleepDebt;
+	int batchedSteps;
+	int hidden;
+	struct timespec hiddenChecked;
+	int tmuxChecked;
+	char tmuxSocket[PATH_MAX];	// empty if not in tmux
+};
+
+// what the growth hooks need to show a tree on screen
+struct screen {
+	struct config *conf;
+	struct ncursesObjects *objects;
+	struct scene *scene;
+	struct counters *myCounters;
 };
 
 void delObjects(struct ncursesObjects *objects) {
@@ -72,10 +179,19 @@ void delObjects(struct ncursesObjects *objects) {
 	delwin(objects->messageWin);
 }
 
-void quit(struct config *conf, struct ncursesObjects *objects, int returnCode) {
+void quit(struct config *conf, struct ncursesObjects *objects, struct scene *scene, int returnCode) {
 	delObjects(objects);
+	cbonsaiArenaRelease(&scene->arena, free);
+	free(scene->leaves.canvas.cells);
+	free(scene->leaves.cells);
+	free(scene->leaves.lit);
 	free(conf->saveFile);
 	free(conf->loadFile);
+	free(conf->leaves);
+	free(conf->leafWeights);
+	free(conf->leafList);
+	free(conf->leafText);
+	cbonsaiArenaRelease(&conf->leafArena, free);
 	exit(returnCode);
 }
 
@@ -116,12 +232,25 @@ int loadFromFile(struct config *conf) {
 	return 0;
 }
 
+double secondsSince(const struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+double wakeupsPerMinute(const struct counters *myCounters) {
+	double minutes = secondsSince(&myCounters->runStart) / 60;
+	return minutes > 0 ? myCounters->wakeups / minutes : 0;
+}
+
 void finish(const struct config *conf, struct counters *myCounters) {
 	clear();
 	refresh();
 	endwin();	// delete ncurses screen
+	if (conf->verbosity)
+		fprintf(stderr, "wakeups: %d (%.1f per minute)\n", myCounters->wakeups, wakeupsPerMinute(myCounters));
 	if (conf->save)
-		saveToFile(conf->saveFile, conf->seed, myCounters->branches);
+		saveToFile(conf->saveFile, conf->seed, myCounters->tree.stats.branches);
 }
 
 void printHelp(void) {
@@ -142,7 +271,8 @@ void printHelp(void) {
 	        "  -m, --message=STR      attach message next to the tree\n"
 	        "  -b, --base=INT         ascii-art plant base to use, 0 is none\n"
 	        "  -c, --leaf=LIST        list of comma-delimited strings randomly chosen\n"
-	        "                           for leaves\n"
+	        "                           for leaves, each optionally weighted as STR=WEIGHT\n"
+	        "  --leaf-file=FILE       read leaves from FILE, one STR[=WEIGHT] per line\n"
 	        "  -M, --multiplier=INT   branch multiplier; higher -> more\n"
 	        "                           branching (0-20) [default: 5]\n"
 	        "  -L, --life=INT         life; higher -> more growth (0-200) [default: 32]\n"
@@ -150,65 +280,71 @@ void printHelp(void) {
 	        "  -s, --seed=INT         seed random number generator\n"
 	        "  -W, --save=FILE        save progress to file [default: $XDG_CACHE_HOME/cbonsai or $HOME/.cache/cbonsai]\n"
 	        "  -C, --load=FILE        load progress from file [default: $XDG_CACHE_HOME/cbonsai]\n"
+	        "  --max-steps=INT        stop growing after INT steps, pruning leaves\n"
+	        "                           first as the budget runs low [default: none]\n"
+	        "  --max-branches=INT     stop growing after INT branches, pruning leaves\n"
+	        "                           first as the budget runs low [default: none]\n"
+	        "  --time-limit=TIME      stop growing after TIME secs, pruning leaves\n"
+	        "                           first as the budget runs low [default: none]\n"
+	        "  --ambient[=FPS]        when the tree is finished, let leaves flicker\n"
+	        "                           at FPS frames per second [default: 4]\n"
+	        "  --max-wakeups=INT      wake up at most INT times per second, batching\n"
+	        "                           steps of live growth, and much less often while\n"
+	        "                           the terminal is not visible [default: none]\n"
+	        "  --format=FORMAT        format of printed trees, and of those rendered\n"
+	        "                           without a terminal: ansi, html or svg\n"
+	        "                           [default: ansi]\n"
+	        "  --threads=N            grow each branch from its own random numbers,\n"
+	        "                           on N threads when printing or rendering without\n"
+	        "                           a terminal; a seed gives the same tree for any N\n"
+	        "  --palette=SPEC         colors: classic, autumn, sakura, mono, and/or\n"
+	        "                           role=COLOR[:COLOR][/COLOR] for the roles wood,\n"
+	        "                           dying, dead, pot, moss, stump and text, with\n"
+	        "                           gradient=depth|age|none [default: classic]\n"
+	        "  --geometry=WxH         size of printed trees, and of those rendered\n"
+	        "                           without a terminal\n"
+	        "                           [default: size of the terminal, or 80x24]\n"
+    );
+	printf("%s",
+	        "  --pregen N FILE        render N trees in parallel into FILE, a ring\n"
+	        "                           of trees for --next\n"
+	        "  --next=FILE            print the next tree of a ring made by --pregen\n"
+	        "  --serve=SOCKET         serve trees to clients of a unix socket\n"
+	        "  --fanout=LIST          grow trees live on each of a comma-delimited\n"
+	        "                           list of ttys, ptys or unix sockets at once\n"
+	        "  --export-scene=FILE    grow a tree into FILE, every branch and painted\n"
+	        "                           step in order: JSON lines if FILE ends in .json\n"
+	        "                           or .jsonl, binary otherwise\n"
+	        "  --load-scene=FILE      print a tree from a scene made by --export-scene\n"
+	        "  --keep-growing=FILE    grow the tree kept in FILE a little further, save\n"
+	        "                           it, and print it; FILE is created if missing\n"
+	        "  --grow-life=INT        with --keep-growing, let each branch grow up to\n"
+	        "                           INT steps [default: 4]\n"
+	        "  --grow-steps=INT       with --keep-growing, grow up to INT steps in all\n"
+	        "                           [default: none]\n"
 	        "  -v, --verbose          increase output verbosity\n"
 	        "  -h, --help             show help\n"
     );
 }
 
-void drawBase(WINDOW* baseWin, int baseType) {
+void drawBase(const struct ncursesObjects *objects, int baseType) {
+	WINDOW* baseWin = objects->baseWin;
+	int baseHeight, baseWidth;
+	const struct cbonsaiBaseSegment *segment = cbonsaiBase(baseType, &baseHeight, &baseWidth);
+
 	// draw base art
-	switch(baseType) {
-	case 1:
-		wattron(baseWin, A_BOLD | COLOR_PAIR(8));
-		wprintw(baseWin, "%s", ":");
-		wattron(baseWin, COLOR_PAIR(2));
-		wprintw(baseWin, "%s", "___________");
-		wattron(baseWin, COLOR_PAIR(11));
-		wprintw(baseWin, "%s", "./~~~\\.");
-		wattron(baseWin, COLOR_PAIR(2));
-		wprintw(baseWin, "%s", "___________");
-		wattron(baseWin, COLOR_PAIR(8));
-		wprintw(baseWin, "%s", ":");
-
-		mvwprintw(baseWin, 1, 0, "%s", " \\                           / ");
-		mvwprintw(baseWin, 2, 0, "%s", "  \\_________________________/ ");
-		mvwprintw(baseWin, 3, 0, "%s", "  (_)                     (_)");
-
-		wattroff(baseWin, A_BOLD);
-		break;
-	case 2:
-		wattron(baseWin, COLOR_PAIR(8));
-		wprintw(baseWin, "%s", "(");
-		wattron(baseWin, COLOR_PAIR(2));
-		wprintw(baseWin, "%s", "---");
-		wattron(baseWin, COLOR_PAIR(11));
-		wprintw(baseWin, "%s", "./~~~\\.");
-		wattron(baseWin, COLOR_PAIR(2));
-		wprintw(baseWin, "%s", "---");
-		wattron(baseWin, COLOR_PAIR(8));
-		wprintw(baseWin, "%s", ")");
-
-		mvwprintw(baseWin, 1, 0, "%s", " (           ) ");
-		mvwprintw(baseWin, 2, 0, "%s", "  (_________)  ");
-		break;
+	for (; segment && segment->str; segment++) {
+		wattrset(baseWin, objects->attrs[segment->attr]);
+		mvwprintw(baseWin, segment->y, segment->x, "%s", segment->str);
 	}
+	wattrset(baseWin, A_NORMAL);
 }
 
 void drawWins(int baseType, struct ncursesObjects *objects) {
-	int baseWidth = 0;
-	int baseHeight = 0;
+	int baseWidth, baseHeight;
 	int rows, cols;
 
-	switch(baseType) {
-	case 1:
-		baseWidth = 31;
-		baseHeight = 4;
-		break;
-	case 2:
-		baseWidth = 15;
-		baseHeight = 3;
-		break;
-	}
+	cbonsaiBase(baseType, &baseHeight, &baseWidth);
 
 	// calculate where base should go
 	getmaxyx(stdscr, rows, cols);
@@ -226,19 +362,18 @@ void drawWins(int baseType, struct ncursesObjects *objects) {
 	objects->basePanel = new_panel(objects->baseWin);
 	objects->treePanel = new_panel(objects->treeWin);
 
-	drawBase(objects->baseWin, baseType);
+	drawBase(objects, baseType);
 }
 
-// roll (randomize) a given die
-void roll(int *dice, int mod) { *dice = rand() % mod; }
-
-// check for key press
-int checkKeyPress(const struct config *conf, struct counters *myCounters) {
-	if ((conf->screensaver && wgetch(stdscr) != ERR) || (wgetch(stdscr) == 'q')) {
-		finish(conf, myCounters);
-		return 1;
+const char* budgetName(enum cbonsaiBudget budget) {
+	switch (budget) {
+	case cbonsaiBudgetLow:
+		return "low, pruning";
+	case cbonsaiBudgetSpent:
+		return "spent";
+	default:
+		return "ok";
 	}
-	return 0;
 }
 
 // display changes
@@ -253,253 +388,55 @@ void updateScreen(float timeStep) {
 	nanosleep(&ts, NULL);	// sleep for given time
 }
 
-// based on type of tree, determine what color a branch should be
-void chooseColor(enum branchType type, WINDOW* treeWin) {
-	switch(type) {
-	case trunk:
-	case shootLeft:
-	case shootRight:
-		if (rand() % 2 == 0) wattron(treeWin, A_BOLD | COLOR_PAIR(11));
-		else wattron(treeWin, COLOR_PAIR(3));
-		break;
-
-	case dying:
-		if (rand() % 10 == 0) wattron(treeWin, A_BOLD | COLOR_PAIR(2));
-		else wattron(treeWin, COLOR_PAIR(2));
-		break;
-
-	case dead:
-		if (rand() % 3 == 0) wattron(treeWin, A_BOLD | COLOR_PAIR(10));
-		else wattron(treeWin, COLOR_PAIR(10));
-		break;
-	}
-}
-
-// determine change in X and Y coordinates of a given branch
-void setDeltas(enum branchType type, int life, int age, int multiplier, int *returnDx, int *returnDy) {
-	int dx = 0;
-	int dy = 0;
-	int dice;
-	switch (type) {
-	case trunk: // trunk
-
-		// new or dead trunk
-		if (age <= 2 || life < 4) {
-			dy = 0;
-			dx = (rand() % 3) - 1;
-		}
-		// young trunk should grow wide
-		else if (age < (multiplier * 3)) {
-
-			// every (multiplier * 0.8) steps, raise tree to next level
-			if (age % (int) (multiplier * 0.5) == 0) dy = -1;
-			else dy = 0;
-
-			roll(&dice, 10);
-			if (dice >= 0 && dice <=0) dx = -2;
-			else if (dice >= 1 && dice <= 3) dx = -1;
-			else if (dice >= 4 && dice <= 5) dx = 0;
-			else if (dice >= 6 && dice <= 8) dx = 1;
-			else if (dice >= 9 && dice <= 9) dx = 2;
-		}
-		// middle-aged trunk
-		else {
-			roll(&dice, 10);
-			if (dice > 2) dy = -1;
-			else dy = 0;
-			dx = (rand() % 3) - 1;
-		}
-		break;
-
-	case 1: // left shoot: trend left and little vertical movement
-		roll(&dice, 10);
-		if (dice >= 0 && dice <= 1) dy = -1;
-		else if (dice >= 2 && dice <= 7) dy = 0;
-		else if (dice >= 8 && dice <= 9) dy = 1;
-
-		roll(&dice, 10);
-		if (dice >= 0 && dice <=1) dx = -2;
-		else if (dice >= 2 && dice <= 5) dx = -1;
-		else if (dice >= 6 && dice <= 8) dx = 0;
-		else if (dice >= 9 && dice <= 9) dx = 1;
-		break;
-
-	case 2: // right shoot: trend right and little vertical movement
-		roll(&dice, 10);
-		if (dice >= 0 && dice <= 1) dy = -1;
-		else if (dice >= 2 && dice <= 7) dy = 0;
-		else if (dice >= 8 && dice <= 9) dy = 1;
-
-		roll(&dice, 10);
-		if (dice >= 0 && dice <=1) dx = 2;
-		else if (dice >= 2 && dice <= 5) dx = 1;
-		else if (dice >= 6 && dice <= 8) dx = 0;
-		else if (dice >= 9 && dice <= 9) dx = -1;
-		break;
-
-	case 3: // dying: discourage vertical growth(?); trend left/right (-3,3)
-		roll(&dice, 10);
-		if (dice >= 0 && dice <=1) dy = -1;
-		else if (dice >= 2 && dice <=8) dy = 0;
-		else if (dice >= 9 && dice <=9) dy = 1;
-
-		roll(&dice, 15);
-		if (dice >= 0 && dice <=0) dx = -3;
-		else if (dice >= 1 && dice <= 2) dx = -2;
-		else if (dice >= 3 && dice <= 5) dx = -1;
-		else if (dice >= 6 && dice <= 8) dx = 0;
-		else if (dice >= 9 && dice <= 11) dx = 1;
-		else if (dice >= 12 && dice <= 13) dx = 2;
-		else if (dice >= 14 && dice <= 14) dx = 3;
-		break;
-
-	case 4: // dead: fill in surrounding area
-		roll(&dice, 10);
-		if (dice >= 0 && dice <= 2) dy = -1;
-		else if (dice >= 3 && dice <= 6) dy = 0;
-		else if (dice >= 7 && dice <= 9) dy = 1;
-		dx = (rand() % 3) - 1;
-		break;
-	}
-
-	*returnDx = dx;
-	*returnDy = dy;
-}
-
-char* chooseString(const struct config *conf, enum branchType type, int life, int dx, int dy) {
-	char* branchStr;
-
-	const unsigned int maxStrLen = 32;
-
-	branchStr = malloc(maxStrLen);
-	strcpy(branchStr, "?");	// fallback character
-
-	if (life < 4) type = dying;
-
-	switch(type) {
-	case trunk:
-		if (dy == 0) strcpy(branchStr, "/~");
-		else if (dx < 0) strcpy(branchStr, "\\|");
-		else if (dx == 0) strcpy(branchStr, "/|\\");
-		else if (dx > 0) strcpy(branchStr, "|/");
-		break;
-	case shootLeft:
-		if (dy > 0) strcpy(branchStr, "\\");
-		else if (dy == 0) strcpy(branchStr, "\\_");
-		else if (dx < 0) strcpy(branchStr, "\\|");
-		else if (dx == 0) strcpy(branchStr, "/|");
-		else if (dx > 0) strcpy(branchStr, "/");
-		break;
-	case shootRight:
-		if (dy > 0) strcpy(branchStr, "/");
-		else if (dy == 0) strcpy(branchStr, "_/");
-		else if (dx < 0) strcpy(branchStr, "\\|");
-		else if (dx == 0) strcpy(branchStr, "/|");
-		else if (dx > 0) strcpy(branchStr, "/");
-		break;
-	case dying:
-	case dead:
-		strncpy(branchStr, conf->leaves[rand() % conf->leavesSize], maxStrLen - 1);
-		branchStr[maxStrLen - 1] = '\0';
-	}
-
-	return branchStr;
-}
-
-void branch(struct config *conf, struct ncursesObjects *objects, struct counters *myCounters, int y, int x, enum branchType type, int life) {
-	myCounters->branches++;
-	int dx = 0;
-	int dy = 0;
-	int age = 0;
-	int shootCooldown = conf->multiplier;
-
-	while (life > 0) {
-		if (checkKeyPress(conf, myCounters) == 1)
-			quit(conf, objects, 0);
-
-		life--;		// decrement remaining life counter
-		age = conf->lifeStart - life;
-
-		setDeltas(type, life, age, conf->multiplier, &dx, &dy);
-
-		int maxY = getmaxy(objects->treeWin);
-		if (dy > 0 && y > (maxY - 2)) dy--; // reduce dy if too close to the ground
-
-		// near-dead branch should branch into a lot of leaves
-		if (life < 3)
-			branch(conf, objects, myCounters, y, x, dead, life);
-
-		// dying trunk should branch into a lot of leaves
-		else if (type == 0 && life < (conf->multiplier + 2))
-			branch(conf, objects, myCounters, y, x, dying, life);
-
-		// dying shoot should branch into a lot of leaves
-		else if ((type == shootLeft || type == shootRight) && life < (conf->multiplier + 2))
-			branch(conf, objects, myCounters, y, x, dying, life);
-
-		// trunks should re-branch if not close to ground AND either randomly, or upon every <multiplier> steps
-		/* else if (type == 0 && ( \ */
-		/* 		(rand() % (conf.multiplier)) == 0 || \ */
-		/* 		(life > conf.multiplier && life % conf.multiplier == 0) */
-		/* 		) ) { */
-		else if (type == trunk && (((rand() % 3) == 0) || (life % conf->multiplier == 0))) {
-
-			// if trunk is branching and not about to die, create another trunk with random life
-			if ((rand() % 8 == 0) && life > 7) {
-				shootCooldown = conf->multiplier * 2;	// reset shoot cooldown
-				branch(conf, objects, myCounters, y, x, trunk, life + (rand() % 5 - 2));
-			}
-
-			// otherwise create a shoot
-			else if (shootCooldown <= 0) {
-				shootCooldown = conf->multiplier * 2;	// reset shoot cooldown
-
-				int shootLife = (life + conf->multiplier);
-
-				// first shoot is randomly directed
-				myCounters->shoots++;
-				myCounters->shootCounter++;
-				if (conf->verbosity) mvwprintw(objects->treeWin, 4, 5, "shoots: %02d", myCounters->shoots);
-
-				// create shoot
-				branch(conf, objects, myCounters, y, x, (myCounters->shootCounter % 2) + 1, shootLife);
-			}
-		}
-		shootCooldown--;
+// guess whether anyone can see the terminal: not if we are a background job,
+// nor if we run in a detached tmux session. this is asked at every wakeup,
+// so the answer is kept for 10 seconds rather than paying a tcgetpgrp() and
+// a stat() each time; the tmux socket path is looked up in TMUX only once
+int terminalHidden(struct counters *myCounters) {
+	if (myCounters->hiddenChecked.tv_sec && secondsSince(&myCounters->hiddenChecked) < 10)
+		return myCounters->hidden;
+	clock_gettime(CLOCK_MONOTONIC, &myCounters->hiddenChecked);
+
+	myCounters->hidden = tcgetpgrp(STDIN_FILENO) != getpgrp();
+
+	// tmux marks its socket executable while any client is attached, so a
+	// stat() tells without asking tmux. the socket is the first field of TMUX
+	if (!myCounters->tmuxChecked) {
+		const char *tmux = getenv("TMUX");
+		if (tmux && strcspn(tmux, ",") < sizeof(myCounters->tmuxSocket))
+			snprintf(myCounters->tmuxSocket, sizeof(myCounters->tmuxSocket), "%.*s", (int) strcspn(tmux, ","), tmux);
+		myCounters->tmuxChecked = 1;
+	}
 
-		if (conf->verbosity > 0) {
-			mvwprintw(objects->treeWin, 5, 5, "dx: %02d", dx);
-			mvwprintw(objects->treeWin, 6, 5, "dy: %02d", dy);
-			mvwprintw(objects->treeWin, 7, 5, "type: %d", type);
-			mvwprintw(objects->treeWin, 8, 5, "shootCooldown: % 3d", shootCooldown);
-		}
+	struct stat st;
+	if (!myCounters->hidden && myCounters->tmuxSocket[0] && stat(myCounters->tmuxSocket, &st) == 0 && !(st.st_mode & S_IXUSR))
+		myCounters->hidden = 1;
 
-		// move in x and y directions
-		x += dx;
-		y += dy;
+	return myCounters->hidden;
+}
 
-		chooseColor(type, objects->treeWin);
+// shortest time between two wakeups, or 0 if wakeups are not capped
+double wakeupInterval(const struct config *conf, struct counters *myCounters) {
+	if (conf->maxWakeups <= 0) return 0;
 
-		// choose string to use for this branch
-		char *branchStr = chooseString(conf, type, life, dx, dy);
+	// nobody is watching, so refresh every couple of seconds at most
+	if (terminalHidden(myCounters)) return 2;
 
-		// grab wide character from branchStr
-		wchar_t wc = 0;
-		mbstate_t *ps = 0;
-		mbrtowc(&wc, branchStr, 32, ps);
+	return 1.0 / conf->maxWakeups;
+}
 
-		// print, but ensure wide characters don't overlap
-		if(x % wcwidth(wc) == 0)
-			mvwprintw(objects->treeWin, y, x, "%s", branchStr);
+// display a step of live growth. when wakeups are capped, steps are batched
+// and the time of the whole batch is slept at once
+void showStep(const struct config *conf, struct counters *myCounters) {
+	myCounters->sleepDebt += conf->timeStep;
+	myCounters->batchedSteps++;
 
-		wattroff(objects->treeWin, A_BOLD);
-		free(branchStr);
+	if (myCounters->sleepDebt < wakeupInterval(conf, myCounters)) return;
 
-		// if live, update screen
-		// skip updating if we're still loading from file
-		if (conf->live && !(conf->load && myCounters->branches < conf->targetBranchCount))
-			updateScreen(conf->timeStep);
-	}
+	updateScreen(myCounters->sleepDebt);
+	myCounters->wakeups++;
+	myCounters->sleepDebt = 0;
+	myCounters->batchedSteps = 0;
 }
 
 void addSpaces(WINDOW* messageWin, int count, int *linePosition, int maxWidth) {
@@ -536,7 +473,8 @@ void createMessageWindows(struct ncursesObjects *objects, char* message) {
 	objects->messageWin = newwin(boxHeight, boxWidth + 1, maxY * 0.7, maxX * 0.7);
 
 	// draw box
-	wattron(objects->messageBorderWin, COLOR_PAIR(8) | A_BOLD);
+	wattrset(objects->messageBorderWin, objects->attrs[CBONSAI_ATTR(cbonsaiRolePot, 1, 0)]);
+	wattrset(objects->messageWin, objects->attrs[CBONSAI_ATTR(cbonsaiRoleText, 0, 0)]);
 	wborder(objects->messageBorderWin, '|', '|', '-', '-', '+', '+', '+', '+');
 
 	// create message panels
@@ -632,6 +570,228 @@ int drawMessage(const struct config *conf, struct ncursesObjects *objects, char*
 	return 0;
 }
 
+// paint a step into the tree window, anchoring the tree to its bottom center
+void drawPaint(const struct ncursesObjects *objects, const struct cbonsaiPaint *paint) {
+	WINDOW* treeWin = objects->treeWin;
+	int maxY, maxX;
+	getmaxyx(treeWin, maxY, maxX);
+	int y = (maxY - 1) + paint->y;
+	int x = (maxX / 2) + paint->x;
+
+	// grab wide character from the paint string, unless its width is known
+	int width = paint->width;
+	if (!width) {
+		wchar_t wc = 0;
+		mbstate_t *ps = 0;
+		mbrtowc(&wc, paint->str, 32, ps);
+		width = wcwidth(wc);
+	}
+
+	// ensure wide characters don't overlap
+	if (width > 1 && x % width != 0) return;
+
+	wattrset(treeWin, objects->attrs[paint->attr]);
+	mvwprintw(treeWin, y, x, "%s", paint->str);
+	wattrset(treeWin, A_NORMAL);
+}
+
+// index the leaves that are still visible in the tree window, i.e. not
+// painted over by later steps or clipped by the window edges
+void indexLeaves(WINDOW* treeWin, struct scene *scene) {
+	struct leafIndex *leaves = &scene->leaves;
+	int maxY, maxX;
+	getmaxyx(treeWin, maxY, maxX);
+
+	size_t canvasSize = (size_t) maxY * maxX;
+	if (canvasSize > leaves->canvasSize) {
+		leaves->canvas.cells = realloc(leaves->canvas.cells, canvasSize * sizeof(*leaves->canvas.cells));
+		leaves->canvasSize = canvasSize;
+	}
+
+	// replay the scene, so only what was painted last is left
+	cbonsaiCanvasInit(&leaves->canvas, leaves->canvas.cells, maxY, maxX);
+	cbonsaiCanvasClear(&leaves->canvas);
+	cbonsaiCanvasPaintScene(&leaves->canvas, &scene->paints);
+
+	leaves->count = 0;
+	for (size_t i = 0; i < canvasSize; i++) {
+		const struct cbonsaiCell *cell = &leaves->canvas.cells[i];
+		if (!cell->glyph[0] || (cell->type != cbonsaiDying && cell->type != cbonsaiDead)) continue;
+
+		if (leaves->count == leaves->capacity) {
+			leaves->capacity = leaves->capacity ? leaves->capacity * 2 : 256;
+			leaves->cells = realloc(leaves->cells, leaves->capacity * sizeof(*leaves->cells));
+			leaves->lit = realloc(leaves->lit, leaves->capacity * sizeof(*leaves->lit));
+		}
+		leaves->cells[leaves->count] = i;
+		leaves->lit[leaves->count] = 0;
+		leaves->count++;
+	}
+}
+
+// draw one frame of ambient animation: flicker a few random leaves by
+// toggling their highlight, repainting only those cells
+void animateLeaves(const struct ncursesObjects *objects, struct scene *scene) {
+	WINDOW* treeWin = objects->treeWin;
+	struct leafIndex *leaves = &scene->leaves;
+	if (leaves->count == 0) return;
+
+	size_t changes = leaves->count / 32 + 1;
+	for (size_t i = 0; i < changes; i++) {
+		size_t leaf = rand() % leaves->count;
+		int offset = leaves->cells[leaf];
+		const struct cbonsaiCell *cell = &leaves->canvas.cells[offset];
+
+		leaves->lit[leaf] = !leaves->lit[leaf];
+		attr_t attr = objects->attrs[cell->attr];
+		if (leaves->lit[leaf]) attr ^= A_BOLD;
+
+		wattrset(treeWin, attr);
+		mvwprintw(treeWin, offset / leaves->canvas.cols, offset % leaves->canvas.cols, "%s", cell->glyph);
+	}
+	wattrset(treeWin, A_NORMAL);
+
+	update_panels();
+	doupdate();
+}
+
+// lay out windows for the current terminal size, then repaint the retained
+// scene into them in a single frame, without growing the tree again
+void relayout(const struct config *conf, struct ncursesObjects *objects, struct scene *scene) {
+	drawWins(conf->baseType, objects);
+	drawMessage(conf, objects, conf->message);
+
+	for (const struct cbonsaiSceneChunk *chunk = scene->paints.first; chunk; chunk = chunk->next) {
+		for (int i = 0; i < chunk->count; i++)
+			drawPaint(objects, &chunk->paints[i]);
+	}
+
+	update_panels();
+	doupdate();
+}
+
+// wait up to the given number of seconds (forever if negative) for a key
+// press, following terminal resizes and animating leaves meanwhile.
+// returns ERR on timeout
+int waitForKey(const struct config *conf, struct ncursesObjects *objects, struct scene *scene, struct counters *myCounters, double seconds) {
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// the leaves were indexed by growNext()
+	int animate = conf->ambientFps > 0 && seconds != 0;
+
+	for (;;) {
+		int delay = -1;
+		if (seconds >= 0) {
+			double left = seconds - secondsSince(&start);
+			delay = left > 0 ? left * 1000 : 0;
+		}
+
+		// wake up for the next animation frame, unless the wait ends first.
+		// without animation, block until a key arrives or the wait is over
+		int frameDelay = 0;
+		if (animate) {
+			frameDelay = 1000 / conf->ambientFps;
+			int minDelay = wakeupInterval(conf, myCounters) * 1000;
+			if (frameDelay < minDelay) frameDelay = minDelay;
+		}
+		int frameDue = animate && (delay < 0 || delay > frameDelay);
+		if (frameDue) delay = frameDelay;
+
+		timeout(delay);
+		int key = wgetch(stdscr);
+		if (delay != 0) myCounters->wakeups++;
+
+		if (key == KEY_RESIZE) {
+			relayout(conf, objects, scene);
+			if (animate) indexLeaves(objects->treeWin, scene);
+		}
+		else if (key == ERR && frameDue)
+			animateLeaves(objects, scene);
+		else
+			return key;
+	}
+}
+
+// check for key press, waiting up to the given number of seconds
+int checkKeyPress(const struct config *conf, struct ncursesObjects *objects, struct scene *scene, struct counters *myCounters, double seconds) {
+	int key = waitForKey(conf, objects, scene, myCounters, seconds);
+	if (key != ERR && (conf->screensaver || key == 'q')) {
+		finish(conf, myCounters);
+		return 1;
+	}
+	return 0;
+}
+
+// before each step of growth: quit on key press
+int onStep(struct cbonsaiTree *tree) {
+	struct screen *screen = tree->userData;
+
+	// when steps are batched, only check for key presses between batches
+	if (screen->myCounters->batchedSteps == 0 && checkKeyPress(screen->conf, screen->objects, screen->scene, screen->myCounters, 0) == 1)
+		quit(screen->conf, screen->objects, screen->scene, 0);
+
+	return 0;
+}
+
+// after each step of growth: keep and show the painted step
+void onPaint(struct cbonsaiTree *tree, const struct cbonsaiPaint *paint) {
+	struct screen *screen = tree->userData;
+	const struct config *conf = screen->conf;
+	WINDOW* treeWin = screen->objects->treeWin;
+
+	cbonsaiSceneAdd(&screen->scene->paints, paint);
+
+	if (conf->verbosity > 0) {
+		mvwprintw(treeWin, 3, 5, "budget: %-12s steps: %06d, pruned: %06d", budgetName(tree->stats.budget), tree->stats.steps, tree->stats.pruned);
+		mvwprintw(treeWin, 4, 5, "shoots: %02d", tree->stats.shoots);
+		mvwprintw(treeWin, 5, 5, "dx: %02d", tree->dx);
+		mvwprintw(treeWin, 6, 5, "dy: %02d", tree->dy);
+		mvwprintw(treeWin, 7, 5, "type: %d", paint->type);
+		mvwprintw(treeWin, 8, 5, "shootCooldown: % 3d", tree->shootCooldown);
+	}
+
+	drawPaint(screen->objects, paint);
+
+	// if live, update screen
+	// skip updating if we're still loading from file
+	if (conf->live && !(conf->load && tree->stats.branches < conf->targetBranchCount))
+		showStep(conf, screen->myCounters);
+}
+
+// resolve the palette to curses attributes, defining a color pair for each
+// color it uses
+void initColors(const struct config *conf, struct ncursesObjects *objects) {
+	// use native background color when possible
+	int bg = COLOR_BLACK;
+	if (has_colors() && use_default_colors() != ERR) bg = -1;
+
+	short pairColors[CBONSAI_ATTRS + 1];
+	int pairs = 1;
+	for (int i = 0; i < CBONSAI_ATTRS; i++) {
+		const struct cbonsaiAttr *attr = &conf->palette.attrs[i];
+		int color = attr->color;
+		if (!has_colors()) color = 0;
+		else if (attr->rgb >= 0 && COLORS >= 256) color = attr->color256;
+
+		// restrict color pallete in non-256color terminals (e.g. screen or linux)
+		else if (COLORS < 256 && color >= 8) color = color == 8 ? 7 : color - 8;	// gray will look white
+
+		// pair 0 is the default color
+		int pair = 0;
+		if (color > 0) {
+			pair = 1;
+			while (pair < pairs && pairColors[pair] != color) pair++;
+			if (pair == pairs && pairs < COLOR_PAIRS) {
+				init_pair(pair, color, bg);
+				pairColors[pairs++] = color;
+			}
+			else if (pair == pairs) pair = 0;
+		}
+		objects->attrs[i] = COLOR_PAIR(pair) | (attr->bold ? A_BOLD : A_NORMAL);
+	}
+}
+
 void init(const struct config *conf, struct ncursesObjects *objects) {
 	savetty();	// save terminal settings
 	initscr();	// init ncurses screen
@@ -641,209 +801,2417 @@ void init(const struct config *conf, struct ncursesObjects *objects) {
 	nodelay(stdscr, TRUE);	// force getch to be a non-blocking call
 
 	// if terminal has color capabilities, use them
-	if (has_colors()) {
-		start_color();
-
-		// use native background color when possible
-		int bg = COLOR_BLACK;
-		if (use_default_colors() != ERR) bg = -1;
-
-		// define color pairs
-		for(int i=0; i<16; i++){
-			init_pair(i, i, bg);
-		}
-
-		// restrict color pallete in non-256color terminals (e.g. screen or linux)
-		if (COLORS < 256) {
-			init_pair(8, 7, bg);	// gray will look white
-			init_pair(9, 1, bg);
-			init_pair(10, 2, bg);
-			init_pair(11, 3, bg);
-			init_pair(12, 4, bg);
-			init_pair(13, 5, bg);
-			init_pair(14, 6, bg);
-			init_pair(15, 7, bg);
-		}
-	} else {
-		printf("%s", "Warning: terminal does not have color support.\n");
-	}
+	if (has_colors()) start_color();
+	else printf("%s", "Warning: terminal does not have color support.\n");
+	initColors(conf, objects);
 
 	// define and draw windows, then create panels
 	drawWins(conf->baseType, objects);
 	drawMessage(conf, objects, conf->message);
 }
 
-void growTree(struct config *conf, struct ncursesObjects *objects, struct counters *myCounters) {
+struct cbonsaiConfig treeConfig(const struct config *conf) {
+	struct cbonsaiConfig treeConf = {
+		.lifeStart = conf->lifeStart,
+		.multiplier = conf->multiplier,
+		.seed = conf->seed,
+		.leaves = conf->leaves,
+		.leavesSize = conf->leavesSize,
+		.leafSet = &conf->leafSet,
+		.maxSteps = conf->maxSteps,
+		.maxBranches = conf->maxBranches,
+		.timeLimit = conf->timeLimit,
+		.palette = &conf->palette,
+		.threads = conf->threads,
+	};
+	return treeConf;
+}
+
+void growTree(struct config *conf, struct ncursesObjects *objects, struct scene *scene, struct counters *myCounters) {
 	int maxY, maxX;
 	getmaxyx(objects->treeWin, maxY, maxX);
 
+	struct cbonsaiConfig treeConf = treeConfig(conf);
+
+	struct screen screen = { conf, objects, scene, myCounters };
+
+	struct cbonsaiTree *tree = &myCounters->tree;
+	tree->conf = &treeConf;
+	tree->onStep = onStep;
+	tree->onPaint = onPaint;
+	tree->userData = &screen;
+
 	// reset counters
-	myCounters->shoots = 0;
-	myCounters->branches = 0;
-	myCounters->shootCounter = rand();
+	myCounters->sleepDebt = 0;
+	myCounters->batchedSteps = 0;
+
+	// start a new scene
+	cbonsaiArenaReset(&scene->arena);
+	cbonsaiSceneInit(&scene->paints, &scene->arena);
 
 	if (conf->verbosity > 0) {
 		mvwprintw(objects->treeWin, 2, 5, "maxX: %03d, maxY: %03d", maxX, maxY);
 	}
 
-	// recursively grow tree trunk and branches
-	branch(conf, objects, myCounters, maxY - 1, (maxX / 2), trunk, conf->lifeStart);
+	cbonsaiGrowTree(tree);
+
+	if (conf->verbosity > 0) {
+		mvwprintw(objects->treeWin, 3, 5, "budget: %-12s steps: %06d, pruned: %06d", budgetName(tree->stats.budget), tree->stats.steps, tree->stats.pruned);
+	}
+
+	// the tree config only lives as long as this function
+	tree->conf = NULL;
 
 	// display changes
 	update_panels();
 	doupdate();
 }
 
-// print stdscr to terminal window
-void printstdscr(void) {
-	int maxY, maxX;
-	getmaxyx(stdscr, maxY, maxX);
+// grow the next tree of the run on screen and index its leaves for ambient
+// animation: all that is done for each tree, besides waiting for the next.
+// once the scene arena and the leaf index have grown to fit the trees, this
+// takes no more memory
+void growNext(struct config *conf, struct ncursesObjects *objects, struct scene *scene, struct counters *myCounters) {
+	growTree(conf, objects, scene, myCounters);
+	if (conf->ambientFps > 0) indexLeaves(objects->treeWin, scene);
+}
 
-	// loop through each character on stdscr
-	for (int y = 0; y < maxY; y++) {
-		for (int x = 0; x < maxX; x++) {
-			// grab cchar_t from stdscr
-			cchar_t c;
-			mvwin_wch(stdscr, y, x, &c);
-
-			// grab wchar_t from cchar_t
-			wchar_t wch[128] = {0};
-			attr_t attrs;
-			short color_pair;
-			getcchar(&c, wch, &attrs, &color_pair, 0);
-
-			short fg;
-			short bg;
-			pair_content(color_pair, &fg, &bg);
-
-			// enable bold if needed
-			if(attrs & A_BOLD) printf("\033[1m");
-			else printf("\033[0m");
-
-			// enable correct color
-			if (fg == 0) printf("\033[0m");
-			else if (fg <= 7) printf("\033[3%him", fg);
-			else if (fg >= 8) printf("\033[9%him", fg - 8);
-
-			printf("%ls", wch);
-
-			short clen = wcslen(wch);
-			short cwidth = 0;
-			for (int i = 0; i < clen; ++i)
-				cwidth += wcwidth(wch[i]);
-
-			if (cwidth > 1)
-				x += cwidth - 1;
-		}
+// size of trees rendered without curses: --geometry, the terminal on stdout,
+// or 80x24 when there is none
+void canvasSize(const struct config *conf, int *rows, int *cols) {
+	struct winsize ws;
+
+	*rows = 24;
+	*cols = 80;
+	if (conf->geometryRows) {
+		*rows = conf->geometryRows;
+		*cols = conf->geometryCols;
+	} else if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col) {
+		*rows = ws.ws_row;
+		*cols = ws.ws_col;
 	}
+}
 
-	printf("\033[0m\n");
+// paint a string at a position of the canvas, rather than relative to the tree
+void paintAt(struct cbonsaiCanvas *canvas, int y, int x, const char *str, unsigned char attr) {
+	struct cbonsaiPaint paint = {
+		.y = y - canvas->anchorY,
+		.x = x - canvas->anchorX,
+		.str = str,
+		.attr = attr,
+		.type = cbonsaiNoBranch,
+	};
+	cbonsaiCanvasPaint(canvas, &paint);
 }
 
-char* createDefaultCachePath(void) {
-	char* result;
-	size_t envlen;
-	char* toAppend;
+// where the next character of a message goes, moving like the cursor of a
+// curses window: to the next line at its edge, and nowhere past its end
+struct messageCursor {
+	struct cbonsaiCanvas *canvas;
+	int top;
+	int left;
+	int width;
+	int height;
+	int y;
+	int x;
+};
 
-	// follow XDG Base Directory Specification for default cache file path
-	const char* env_XDG_CACHE_HOME = getenv("XDG_CACHE_HOME");
-	if (env_XDG_CACHE_HOME && (envlen = strlen(env_XDG_CACHE_HOME))) {
-		toAppend = "/cbonsai";
+void putMessage(struct messageCursor *cursor, const char *str) {
+	int len = strlen(str);
+	for (int i = 0; i < len && cursor->y < cursor->height;) {
+		if (str[i] == '\n') {
+			cursor->y++;
+			cursor->x = 0;
+			i++;
+			continue;
+		}
 
-		// create result buffer
-		result = malloc(envlen + strlen(toAppend) + 1);
-		strncpy(result, env_XDG_CACHE_HOME, envlen);
-		strcpy(result + envlen, toAppend);
-		return result;
+		char ch[MB_LEN_MAX + 1] = {0};
+		int chLength = mblen(str + i, len - i);
+		if (chLength < 1) chLength = 1;
+		memcpy(ch, str + i, chLength);
+		i += chLength;
+
+		paintAt(cursor->canvas, cursor->top + cursor->y, cursor->left + cursor->x, ch, CBONSAI_ATTR(cbonsaiRoleText, 0, 0));
+		if (++cursor->x == cursor->width) {
+			cursor->y++;
+			cursor->x = 0;
+		}
 	}
+}
 
-	// if we don't have $XDG_CACHE_HOME, try $HOME
-	const char* env_HOME = getenv("HOME");
-	if (env_HOME && (envlen = strlen(env_HOME))) {
-		toAppend = "/.cache/cbonsai";
+// paint the message box, laid out and word wrapped like drawMessage() does
+void paintMessage(struct cbonsaiCanvas *canvas, const char *message, int verbosity) {
+	int rows = canvas->rows, cols = canvas->cols;
+	int len = strlen(message);
 
-		// create result buffer
-		result = malloc(envlen + strlen(toAppend) + 1);
-		strncpy(result, env_HOME, envlen);
-		strcpy(result + envlen, toAppend);
-		return result;
+	int boxWidth = 0;
+	int boxHeight = 0;
+	if (len + 3 <= (0.25 * cols)) {
+		boxWidth = len + 1;
+		boxHeight = 1;
+	} else {
+		boxWidth = 0.25 * cols;
+		if (boxWidth < 1) return;
+		boxHeight = (len / boxWidth) + (len / boxWidth);
 	}
 
-	// if we also don't have $HOME, just use ./cbonsai
-	toAppend = "cbonsai";
-	result = malloc(strlen(toAppend) + 1);
-	strcpy(result, toAppend);
-	return result;
+	// the border, blanking the tree behind the box
+	int top = (rows * 0.7) - 1, left = (cols * 0.7) - 2;
+	int height = boxHeight + 2, width = boxWidth + 4;
+	char line[width + 1];
+	for (int y = 0; y < height; y++) {
+		int edge = (y == 0 || y == height - 1);
+		memset(line, edge ? '-' : ' ', width);
+		line[0] = line[width - 1] = edge ? '+' : '|';
+		line[width] = '\0';
+		paintAt(canvas, top + y, left, line, CBONSAI_ATTR(cbonsaiRolePot, 1, 0));
+	}
+
+	// the message, word wrapped like drawMessage() does
+	struct messageCursor cursor = { canvas, rows * 0.7, cols * 0.7, boxWidth + 1, boxHeight, 0, 0 };
+	int maxWidth = cursor.width - 2;
+	int linePosition = 0;
+	int wordLength = 0;
+	char wordBuffer[512] = {'\0'};
+	for (int i = 0; ; i++) {
+		char thisChar = message[i];
+
+		if (!(isspace(thisChar) || thisChar == '\0')) {
+			if (wordLength < (int) sizeof(wordBuffer) - 1) {
+				wordBuffer[wordLength] = thisChar;
+				wordBuffer[wordLength + 1] = '\0';
+			}
+			wordLength++;
+			linePosition++;
+		}
+
+		// if current line can fit word, add word to current line
+		else if (linePosition <= maxWidth) {
+			putMessage(&cursor, wordBuffer);
+			if ((thisChar == ' ' || thisChar == '\t') && linePosition < maxWidth - 1) {
+				putMessage(&cursor, " ");
+				linePosition++;
+			} else if (thisChar == '\n') {
+				putMessage(&cursor, "\n");
+				linePosition = 0;
+			}
+		}
+
+		// if word can't fit within a single line, just print it
+		else if (wordLength > maxWidth) {
+			putMessage(&cursor, wordBuffer);
+			putMessage(&cursor, " ");
+			linePosition = cursor.x;
+		}
+
+		// if current line can't fit word, go to next line
+		else {
+			putMessage(&cursor, "\n");
+			putMessage(&cursor, wordBuffer);
+			putMessage(&cursor, " ");
+			linePosition = wordLength;
+		}
+
+		if (isspace(thisChar) || thisChar == '\0') {
+			wordLength = 0;
+			wordBuffer[0] = '\0';
+		}
+		if (thisChar == '\0') {
+			if (verbosity > 0) {
+				char verbose[32];
+				snprintf(verbose, sizeof(verbose), "index: %03d", i);
+				paintAt(canvas, 9, 5, verbose, CBONSAI_ATTR(cbonsaiRoleText, 0, 0));
+				snprintf(verbose, sizeof(verbose), "linePosition: %02d", linePosition);
+				paintAt(canvas, 10, 5, verbose, CBONSAI_ATTR(cbonsaiRoleText, 0, 0));
+			}
+			break;
+		}
+	}
 }
 
-int main(int argc, char* argv[]) {
-	setlocale(LC_ALL, "");
+// anchor the tree on a canvas where drawWins() puts it: above the base.
+// the canvas is written out in the configured palette
+void anchorCanvas(const struct config *conf, struct cbonsaiCanvas *canvas) {
+	int baseHeight, baseWidth;
+	cbonsaiBase(conf->baseType, &baseHeight, &baseWidth);
 
-	struct config conf = {
-		.live = 0,
-		.infinite = 0,
-		.screensaver = 0,
-		.printTree = 0,
-		.verbosity = 0,
-		.lifeStart = 32,
-		.multiplier = 5,
-		.baseType = 1,
-		.seed = 0,
-		.leavesSize = 0,
-		.save = 0,
-		.load = 0,
-		.targetBranchCount = 0,
+	canvas->anchorY = canvas->rows - baseHeight - 1;
+	canvas->anchorX = canvas->cols / 2;
+	canvas->palette = &conf->palette;
+}
 
-		.timeWait = 4,
-		.timeStep = 0.03,
+// paint what surrounds the tree: its base, and the message box
+void paintSurroundings(const struct config *conf, struct cbonsaiCanvas *canvas) {
+	cbonsaiCanvasPaintBase(canvas, conf->baseType);
+	if (conf->message) paintMessage(canvas, conf->message, conf->verbosity);
+}
 
-		.message = NULL,
-		.leaves = {0},
-		.saveFile = createDefaultCachePath(),
-		.loadFile = createDefaultCachePath(),
-	};
+// paint what -v shows in the tree window while a tree grows, as it is left
+// once the tree is done. type is that of the last step painted
+void paintVerbose(const struct config *conf, struct cbonsaiCanvas *canvas, const struct cbonsaiTree *tree, int type) {
+	int baseHeight, baseWidth;
+	cbonsaiBase(conf->baseType, &baseHeight, &baseWidth);
+
+	const unsigned char attr = CBONSAI_ATTR(cbonsaiRoleText, 0, 0);
+	char line[64];
+	snprintf(line, sizeof(line), "maxX: %03d, maxY: %03d", canvas->cols, canvas->rows - baseHeight);
+	paintAt(canvas, 2, 5, line, attr);
+	snprintf(line, sizeof(line), "budget: %-12s steps: %06d, pruned: %06d", budgetName(tree->stats.budget), tree->stats.steps, tree->stats.pruned);
+	paintAt(canvas, 3, 5, line, attr);
+	snprintf(line, sizeof(line), "shoots: %02d", tree->stats.shoots);
+	paintAt(canvas, 4, 5, line, attr);
+	snprintf(line, sizeof(line), "dx: %02d", tree->dx);
+	paintAt(canvas, 5, 5, line, attr);
+	snprintf(line, sizeof(line), "dy: %02d", tree->dy);
+	paintAt(canvas, 6, 5, line, attr);
+	snprintf(line, sizeof(line), "type: %d", type);
+	paintAt(canvas, 7, 5, line, attr);
+	snprintf(line, sizeof(line), "shootCooldown: % 3d", tree->shootCooldown);
+	paintAt(canvas, 8, 5, line, attr);
+}
 
-	struct option long_options[] = {
-		{"live", no_argument, NULL, 'l'},
-		{"time", required_argument, NULL, 't'},
-		{"infinite", no_argument, NULL, 'i'},
-		{"wait", required_argument, NULL, 'w'},
-		{"screensaver", no_argument, NULL, 'S'},
-		{"message", required_argument, NULL, 'm'},
-		{"base", required_argument, NULL, 'b'},
-		{"leaf", required_argument, NULL, 'c'},
-		{"multiplier", required_argument, NULL, 'M'},
-		{"life", required_argument, NULL, 'L'},
-		{"print", required_argument, NULL, 'p'},
-		{"seed", required_argument, NULL, 's'},
-		{"save", required_argument, NULL, 'W'},
-		{"load", required_argument, NULL, 'C'},
-		{"verbose", no_argument, NULL, 'v'},
-		{"help", no_argument, NULL, 'h'},
-		{0, 0, 0, 0}
-	};
+// grow a tree with its base and message onto a canvas, laid out like
+// drawWins() and drawMessage() do. stats may be NULL
+void growCanvas(const struct config *conf, struct cbonsaiCanvas *canvas, unsigned long seed, struct cbonsaiStats *stats) {
+	struct cbonsaiConfig treeConf = treeConfig(conf);
+	treeConf.seed = seed;
 
-	struct ncursesObjects objects = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+	anchorCanvas(conf, canvas);
+	cbonsaiGrow(&treeConf, canvas, NULL, stats);
+	paintSurroundings(conf, canvas);
+}
 
-	char leavesInput[128] = "&";
+int parseFormat(const char *name, enum outputFormat *format) {
+	if (!strcmp(name, "ansi")) *format = formatAnsi;
+	else if (!strcmp(name, "html")) *format = formatHtml;
+	else if (!strcmp(name, "svg")) *format = formatSvg;
+	else return -1;
+	return 0;
+}
 
-	// parse arguments
-	int option_index = 0;
-	int c;
-	while ((c = getopt_long(argc, argv, ":lt:iw:Sm:b:c:M:L:ps:C:W:vh", long_options, &option_index)) != -1) {
-		switch (c) {
-		case 'l':
-			conf.live = 1;
-			break;
-		case 't':
-			if (strtold(optarg, NULL) != 0) conf.timeStep = strtod(optarg, NULL);
-			else {
-				printf("error: invalid step time: '%s'\n", optarg);
-				quit(&conf, &objects, 1);
-			}
-			if (conf.timeStep < 0) {
-				printf("error: invalid step time: '%s'\n", optarg);
-				quit(&conf, &objects, 1);
+int writeFormat(const struct cbonsaiCanvas *canvas, enum outputFormat format, FILE *fp) {
+	switch (format) {
+	case formatAnsi:
+		return cbonsaiCanvasWriteAnsi(canvas, fp);
+	case formatHtml:
+		return cbonsaiCanvasWriteHtml(canvas, fp);
+	case formatSvg:
+		return cbonsaiCanvasWriteSvg(canvas, fp);
+	}
+	return -1;
+}
+
+// write a tree out for -p. in ANSI, every row of the screen is written, blank
+// ones above the tree too, as -p has always done
+int printFormat(const struct cbonsaiCanvas *canvas, enum outputFormat format) {
+	int failed = (format == formatAnsi) ? cbonsaiCanvasWriteAnsiScreen(canvas, stdout) : writeFormat(canvas, format, stdout);
+	return failed != 0 || fflush(stdout) != 0;
+}
+
+// a tree grown for -p -v, keeping the type of its last step
+struct verboseGrowth {
+	struct cbonsaiCanvas *canvas;
+	int type;
+};
+
+void paintVerboseStep(struct cbonsaiTree *tree, const struct cbonsaiPaint *paint) {
+	struct verboseGrowth *growth = tree->userData;
+	cbonsaiCanvasPaint(growth->canvas, paint);
+	growth->type = paint->type;
+}
+
+// grow a tree onto a canvas like growCanvas() does, but on this thread, so
+// that what -v shows of its last step can be painted over it
+void growVerbose(const struct config *conf, struct cbonsaiCanvas *canvas, struct cbonsaiStats *stats) {
+	struct cbonsaiConfig treeConf = treeConfig(conf);
+	struct verboseGrowth growth = { canvas, cbonsaiNoBranch };
+
+	struct cbonsaiTree tree;
+	memset(&tree, 0, sizeof(tree));
+	tree.conf = &treeConf;
+	tree.onPaint = paintVerboseStep;
+	tree.userData = &growth;
+
+	anchorCanvas(conf, canvas);
+	cbonsaiCanvasClear(canvas);
+	cbonsaiGrowTree(&tree);
+	paintVerbose(conf, canvas, &tree, growth.type);
+	paintSurroundings(conf, canvas);
+	*stats = tree.stats;
+}
+
+// grow a tree and print it, without setting up the terminal
+int printCanvas(const struct config *conf) {
+	int rows, cols;
+	canvasSize(conf, &rows, &cols);
+
+	struct cbonsaiCanvas canvas;
+	struct cbonsaiCell *cells = malloc((size_t) rows * cols * sizeof(*cells));
+	if (!cells) return 1;
+	cbonsaiCanvasInit(&canvas, cells, rows, cols);
+
+	struct cbonsaiStats stats;
+	if (conf->verbosity > 0) growVerbose(conf, &canvas, &stats);
+	else growCanvas(conf, &canvas, conf->seed, &stats);
+	int failed = printFormat(&canvas, conf->format);
+	free(cells);
+
+	if (conf->save)
+		saveToFile(conf->saveFile, conf->seed, stats.branches);
+	return failed;
+}
+
+// print a tree that was grown on screen, from its scene
+int printScene(const struct config *conf, const struct scene *scene, const struct cbonsaiTree *tree, int rows, int cols) {
+	struct cbonsaiCanvas canvas;
+	struct cbonsaiCell *cells = calloc((size_t) rows * cols, sizeof(*cells));
+	if (!cells) return 1;
+	cbonsaiCanvasInit(&canvas, cells, rows, cols);
+
+	anchorCanvas(conf, &canvas);
+	cbonsaiCanvasPaintScene(&canvas, &scene->paints);
+	if (conf->verbosity > 0) {
+		const struct cbonsaiSceneChunk *last = scene->paints.last;
+		paintVerbose(conf, &canvas, tree, (last && last->count) ? last->paints[last->count - 1].type : cbonsaiNoBranch);
+	}
+	paintSurroundings(conf, &canvas);
+
+	int failed = printFormat(&canvas, conf->format);
+	free(cells);
+	return failed;
+}
+
+/* scene files, written by --export-scene and read by --load-scene */
+
+// a binary scene file starts with SCENE_MAGIC, SCENE_VERSION, the seed, life
+// and multiplier, followed by records: 'B' for a branch as it starts, 'P' for
+// a painted step, and 'E' with the stats once the tree is finished. numbers
+// are little-endian, of the sizes written by the functions below. a file
+// named *.json or *.jsonl holds the same as one JSON object per line instead
+#define SCENE_MAGIC "cbscene"
+#define SCENE_VERSION 1
+
+struct sceneWriter {
+	FILE* fp;
+	int json;
+};
+
+const char* const branchTypeNames[] = {"trunk", "shootLeft", "shootRight", "dying", "dead", "none"};
+
+int sceneIsJson(const char *fname) {
+	const char *dot = strrchr(fname, '.');
+	return dot && (!strcmp(dot, ".json") || !strcmp(dot, ".jsonl"));
+}
+
+void putNumber(FILE *fp, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; i++)
+		fputc((value >> (8 * i)) & 0xff, fp);
+}
+
+int getNumber(FILE *fp, uint64_t *value, int bytes) {
+	*value = 0;
+	for (int i = 0; i < bytes; i++) {
+		int c = fgetc(fp);
+		if (c == EOF) return -1;
+		*value |= (uint64_t) c << (8 * i);
+	}
+	return 0;
+}
+
+// a signed 32-bit number
+int getInt(FILE *fp, int *value) {
+	uint64_t raw;
+	if (getNumber(fp, &raw, 4) != 0) return -1;
+	*value = (int32_t) (uint32_t) raw;
+	return 0;
+}
+
+void putJsonString(FILE *fp, const char *str) {
+	fputc('"', fp);
+	for (; *str; str++) {
+		unsigned char c = *str;
+		if (c == '"' || c == '\\') fprintf(fp, "\\%c", c);
+		else if (c < 0x20) fprintf(fp, "\\u%04x", c);
+		else fputc(c, fp);
+	}
+	fputc('"', fp);
+}
+
+void exportBranch(struct cbonsaiTree *tree, const struct cbonsaiBranch *branch) {
+	struct sceneWriter *writer = tree->userData;
+	if (writer->json) {
+		fprintf(writer->fp, "{\"branch\":%d,\"parent\":%d,\"type\":\"%s\",\"y\":%d,\"x\":%d,\"life\":%d,\"depth\":%d}\n",
+				branch->id, branch->parent, branchTypeNames[branch->type], branch->y, branch->x, branch->life, branch->depth);
+		return;
+	}
+
+	fputc('B', writer->fp);
+	putNumber(writer->fp, (uint32_t) branch->id, 4);
+	putNumber(writer->fp, (uint32_t) branch->parent, 4);
+	putNumber(writer->fp, branch->type, 1);
+	putNumber(writer->fp, (uint32_t) branch->y, 4);
+	putNumber(writer->fp, (uint32_t) branch->x, 4);
+	putNumber(writer->fp, (uint32_t) branch->life, 4);
+	putNumber(writer->fp, (uint32_t) branch->depth, 4);
+}
+
+void exportPaint(struct cbonsaiTree *tree, const struct cbonsaiPaint *paint) {
+	struct sceneWriter *writer = tree->userData;
+	if (writer->json) {
+		fprintf(writer->fp, "{\"paint\":%d,\"branch\":%d,\"y\":%d,\"x\":%d,\"str\":",
+				tree->stats.steps, tree->branch, paint->y, paint->x);
+		putJsonString(writer->fp, paint->str);
+		fprintf(writer->fp, ",\"width\":%d,\"attr\":%d,\"type\":\"%s\"}\n",
+				paint->width, paint->attr, branchTypeNames[paint->type]);
+		return;
+	}
+
+	size_t len = strlen(paint->str);
+	fputc('P', writer->fp);
+	putNumber(writer->fp, (uint32_t) tree->stats.steps, 4);
+	putNumber(writer->fp, (uint32_t) tree->branch, 4);
+	putNumber(writer->fp, (uint32_t) paint->y, 4);
+	putNumber(writer->fp, (uint32_t) paint->x, 4);
+	putNumber(writer->fp, paint->width, 1);
+	putNumber(writer->fp, paint->attr, 1);
+	putNumber(writer->fp, paint->type, 1);
+	putNumber(writer->fp, len, 4);
+	fwrite(paint->str, 1, len, writer->fp);
+}
+
+// grow a tree and write its scene as it grows, so that a scene of any size
+// takes no more memory than growing the tree
+int exportScene(const struct config *conf) {
+	const char *fname = conf->exportFile;
+	FILE *fp = strcmp(fname, "-") ? fopen(fname, "w") : stdout;
+	if (!fp) {
+		printf("error: file was not opened properly for writing: %s\n", fname);
+		return 1;
+	}
+
+	struct sceneWriter writer = { fp, sceneIsJson(fname) };
+	if (writer.json) {
+		fprintf(fp, "{\"scene\":%d,\"seed\":%d,\"life\":%d,\"multiplier\":%d}\n",
+				SCENE_VERSION, conf->seed, conf->lifeStart, conf->multiplier);
+	} else {
+		fwrite(SCENE_MAGIC, 1, sizeof(SCENE_MAGIC), fp);
+		putNumber(fp, SCENE_VERSION, 4);
+		putNumber(fp, (uint32_t) conf->seed, 8);
+		putNumber(fp, (uint32_t) conf->lifeStart, 4);
+		putNumber(fp, (uint32_t) conf->multiplier, 4);
+	}
+
+	struct cbonsaiConfig treeConf = treeConfig(conf);
+	struct cbonsaiTree tree = {0};
+	tree.conf = &treeConf;
+	tree.onBranch = exportBranch;
+	tree.onPaint = exportPaint;
+	tree.userData = &writer;
+	cbonsaiGrowTree(&tree);
+
+	const struct cbonsaiStats *stats = &tree.stats;
+	if (writer.json) {
+		fprintf(fp, "{\"end\":1,\"steps\":%d,\"branches\":%d,\"shoots\":%d,\"pruned\":%d}\n",
+				stats->steps, stats->branches, stats->shoots, stats->pruned);
+	} else {
+		fputc('E', fp);
+		putNumber(fp, (uint32_t) stats->steps, 4);
+		putNumber(fp, (uint32_t) stats->branches, 4);
+		putNumber(fp, (uint32_t) stats->shoots, 4);
+		putNumber(fp, (uint32_t) stats->pruned, 4);
+	}
+
+	int failed = ferror(fp) != 0;
+	if (fp == stdout) failed |= fflush(fp) != 0;
+	else failed |= fclose(fp) != 0;
+	if (failed) printf("error: could not write scene to '%s'\n", fname);
+
+	if (conf->save)
+		saveToFile(conf->saveFile, conf->seed, stats->branches);
+	return failed;
+}
+
+// the value of a field in a line of a JSON scene, or NULL. the writer escapes
+// every quote within strings, so a key cannot be matched inside a value
+char* jsonField(char *line, const char *key) {
+	char pattern[32];
+	snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+	char *field = strstr(line, pattern);
+	return field ? field + strlen(pattern) : NULL;
+}
+
+int jsonInt(char *line, const char *key, int *value) {
+	const char *field = jsonField(line, key);
+	char *end;
+	if (!field) return -1;
+	long number = strtol(field, &end, 10);
+	if (end == field || number < INT_MIN || number > INT_MAX) return -1;
+	*value = number;
+	return 0;
+}
+
+int hexDigits(const char *str, int count, unsigned *value) {
+	*value = 0;
+	for (int i = 0; i < count; i++) {
+		if (!isxdigit((unsigned char) str[i])) return -1;
+		*value = *value * 16 + (isdigit((unsigned char) str[i]) ? str[i] - '0' : tolower((unsigned char) str[i]) - 'a' + 10);
+	}
+	return 0;
+}
+
+// decode a JSON string in place, returning -1 if it is invalid
+int jsonString(char *line, const char *key, char **value) {
+	char *in = jsonField(line, key);
+	if (!in || *in++ != '"') return -1;
+
+	char *out = in;
+	*value = out;
+	while (*in != '"') {
+		if (!*in) return -1;
+		if (*in != '\\') {
+			*out++ = *in++;
+			continue;
+		}
+
+		in++;
+		unsigned code;
+		switch (*in++) {
+		case '"': *out++ = '"'; continue;
+		case '\\': *out++ = '\\'; continue;
+		case '/': *out++ = '/'; continue;
+		case 'b': *out++ = '\b'; continue;
+		case 'f': *out++ = '\f'; continue;
+		case 'n': *out++ = '\n'; continue;
+		case 'r': *out++ = '\r'; continue;
+		case 't': *out++ = '\t'; continue;
+		case 'u':
+			if (hexDigits(in, 4, &code) != 0) return -1;
+			in += 4;
+			break;
+		default:
+			return -1;
+		}
+
+		// a surrogate pair makes up one character beyond the BMP
+		unsigned low;
+		if (code >= 0xd800 && code < 0xdc00) {
+			if (in[0] != '\\' || in[1] != 'u' || hexDigits(in + 2, 4, &low) != 0 || low < 0xdc00 || low >= 0xe000)
+				return -1;
+			code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+			in += 6;
+		}
+
+		if (code == 0 || (code >= 0xdc00 && code < 0xe000)) return -1;
+		if (code < 0x80) {
+			*out++ = code;
+		} else if (code < 0x800) {
+			*out++ = 0xc0 | (code >> 6);
+			*out++ = 0x80 | (code & 0x3f);
+		} else if (code < 0x10000) {
+			*out++ = 0xe0 | (code >> 12);
+			*out++ = 0x80 | ((code >> 6) & 0x3f);
+			*out++ = 0x80 | (code & 0x3f);
+		} else {
+			*out++ = 0xf0 | (code >> 18);
+			*out++ = 0x80 | ((code >> 12) & 0x3f);
+			*out++ = 0x80 | ((code >> 6) & 0x3f);
+			*out++ = 0x80 | (code & 0x3f);
+		}
+	}
+	*out = '\0';
+	return 0;
+}
+
+// paint the steps of a JSON scene, one line at a time
+int paintJsonScene(FILE *fp, struct cbonsaiCanvas *canvas) {
+	char *line = NULL;
+	size_t size = 0;
+	int version = 0;
+	int ended = 0;
+
+	while (!ended && getline(&line, &size, fp) > 0) {
+		if (!version) {
+			if (jsonInt(line, "scene", &version) != 0 || version != SCENE_VERSION) break;
+			continue;
+		}
+
+		if (jsonField(line, "end")) {
+			ended = 1;
+		} else if (jsonField(line, "paint")) {
+			struct cbonsaiPaint paint = {0};
+			int width, attr;
+			if (jsonInt(line, "y", &paint.y) != 0 || jsonInt(line, "x", &paint.x) != 0
+					|| jsonInt(line, "width", &width) != 0 || jsonInt(line, "attr", &attr) != 0
+					|| attr < 0 || attr >= CBONSAI_ATTRS || width < 0 || width > 2)
+				break;
+			paint.width = width;
+			paint.attr = attr;
+
+			paint.type = cbonsaiNoBranch;
+			const char *type = jsonField(line, "type");
+			for (int i = 0; type && i < cbonsaiNoBranch; i++) {
+				size_t len = strlen(branchTypeNames[i]);
+				if (type[0] == '"' && !strncmp(type + 1, branchTypeNames[i], len) && type[len + 1] == '"')
+					paint.type = i;
+			}
+
+			// the string comes last, as decoding it ends the line there
+			char *str;
+			if (jsonString(line, "str", &str) != 0) break;
+			paint.str = str;
+			cbonsaiCanvasPaint(canvas, &paint);
+		} else if (!jsonField(line, "branch")) {
+			break;
+		}
+	}
+
+	free(line);
+	return ended ? 0 : -1;
+}
+
+// paint the steps of a binary scene, one record at a time
+int paintBinaryScene(FILE *fp, struct cbonsaiCanvas *canvas) {
+	char magic[sizeof(SCENE_MAGIC)];
+	uint64_t version, skip;
+	if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, SCENE_MAGIC, sizeof(magic)) != 0
+			|| getNumber(fp, &version, 4) != 0 || version != SCENE_VERSION
+			|| getNumber(fp, &skip, 8) != 0 || getNumber(fp, &skip, 4) != 0 || getNumber(fp, &skip, 4) != 0)
+		return -1;
+
+	char *str = NULL;
+	size_t size = 0;
+	int failed = -1;
+	int tag;
+	while ((tag = fgetc(fp)) != EOF) {
+		if (tag == 'E') {
+			failed = 0;
+			break;
+		} else if (tag == 'B') {
+			// branches are not needed for painting
+			char branch[25];
+			if (fread(branch, 1, sizeof(branch), fp) != sizeof(branch)) break;
+		} else if (tag == 'P') {
+			struct cbonsaiPaint paint;
+			uint64_t width, attr, type, len;
+			if (getNumber(fp, &skip, 8) != 0 || getInt(fp, &paint.y) != 0 || getInt(fp, &paint.x) != 0
+					|| getNumber(fp, &width, 1) != 0 || getNumber(fp, &attr, 1) != 0 || getNumber(fp, &type, 1) != 0
+					|| getNumber(fp, &len, 4) != 0 || width > 2 || attr >= CBONSAI_ATTRS || type > cbonsaiNoBranch)
+				break;
+
+			if (len >= size) {
+				char *bigger = realloc(str, len + 1);
+				if (!bigger) break;
+				str = bigger;
+				size = len + 1;
+			}
+			if (fread(str, 1, len, fp) != len) break;
+			str[len] = '\0';
+
+			paint.str = str;
+			paint.width = width;
+			paint.attr = attr;
+			paint.type = type;
+			cbonsaiCanvasPaint(canvas, &paint);
+		} else {
+			break;
+		}
+	}
+
+	free(str);
+	return failed;
+}
+
+// print a tree from its scene file, without growing it again
+int printSceneFile(const struct config *conf) {
+	const char *fname = conf->sceneFile;
+	FILE *fp = strcmp(fname, "-") ? fopen(fname, "r") : stdin;
+	if (!fp) {
+		printf("error: file was not opened properly for reading: %s\n", fname);
+		return 1;
+	}
+
+	int rows, cols;
+	canvasSize(conf, &rows, &cols);
+
+	struct cbonsaiCanvas canvas;
+	struct cbonsaiCell *cells = malloc((size_t) rows * cols * sizeof(*cells));
+	if (!cells) return 1;
+	cbonsaiCanvasInit(&canvas, cells, rows, cols);
+	cbonsaiCanvasClear(&canvas);
+	anchorCanvas(conf, &canvas);
+
+	// JSON scenes start with an object, binary ones with SCENE_MAGIC
+	int first = fgetc(fp);
+	ungetc(first, fp);
+	int failed = (first == '{' ? paintJsonScene(fp, &canvas) : paintBinaryScene(fp, &canvas)) != 0;
+	if (fp != stdin) fclose(fp);
+
+	if (failed) {
+		printf("error: not a scene, or a scene cut short: '%s'\n", fname);
+	} else {
+		paintSurroundings(conf, &canvas);
+		failed = writeFormat(&canvas, conf->format, stdout) != 0 || fflush(stdout) != 0;
+	}
+
+	free(cells);
+	return failed;
+}
+
+/* trees that keep growing from one run to the next, with --keep-growing */
+
+// a growth file starts with GROWTH_MAGIC, GROWTH_VERSION, the seed, life and
+// multiplier of the tree, and the size of its canvas and where its trunk is.
+// each run appends a record of its installment: its size, the stats so far,
+// the cells it changed, and every tip still growing. only the tips of the last record
+// are loaded, and once the records take twice what a single one would, the
+// file is rewritten as one. numbers are little-endian, as in scene files
+#define GROWTH_MAGIC "cbgrow"
+#define GROWTH_VERSION 1
+
+// bytes of the header, of a record without its cells and tips, and of a
+// cell without its glyph and a tip in a growth file
+#define GROWTH_HEADER_SIZE (sizeof(GROWTH_MAGIC) + 4 + 8 + 6 * 4)
+#define GROWTH_RECORD_SIZE (6 * 4)
+#define GROWTH_CELL_SIZE (2 + 2 + 4)
+#define GROWTH_TIP_SIZE (9 * 4 + 8 + 4 + 1)
+
+struct growth {
+	int seed;
+	int lifeStart;
+	int multiplier;
+	struct cbonsaiStats stats;
+	struct cbonsaiCanvas canvas;
+	struct cbonsaiCell *grown;	// the canvas as the last run left it
+	struct cbonsaiTips tips;
+	struct cbonsaiArena arena;
+	long end;			// where the last complete record ends
+};
+
+void paintGrowth(struct cbonsaiTree *tree, const struct cbonsaiPaint *paint) {
+	cbonsaiCanvasPaint(tree->userData, paint);
+}
+
+int emptyCell(const struct cbonsaiCell *cell) {
+	static const struct cbonsaiCell empty;
+	return !memcmp(cell, &empty, sizeof(empty));
+}
+
+void putGrowthHeader(FILE *fp, const struct growth *state) {
+	fwrite(GROWTH_MAGIC, 1, sizeof(GROWTH_MAGIC), fp);
+	putNumber(fp, GROWTH_VERSION, 4);
+	putNumber(fp, (uint32_t) state->seed, 8);
+	putNumber(fp, (uint32_t) state->lifeStart, 4);
+	putNumber(fp, (uint32_t) state->multiplier, 4);
+	putNumber(fp, (uint32_t) state->canvas.rows, 4);
+	putNumber(fp, (uint32_t) state->canvas.cols, 4);
+	putNumber(fp, (uint32_t) state->canvas.anchorY, 4);
+	putNumber(fp, (uint32_t) state->canvas.anchorX, 4);
+}
+
+int getGrowthHeader(FILE *fp, struct growth *state) {
+	char magic[sizeof(GROWTH_MAGIC)];
+	uint64_t version, seed;
+	int rows, cols;
+	if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, GROWTH_MAGIC, sizeof(magic)) != 0
+			|| getNumber(fp, &version, 4) != 0 || version != GROWTH_VERSION || getNumber(fp, &seed, 8) != 0
+			|| getInt(fp, &state->lifeStart) != 0 || getInt(fp, &state->multiplier) != 0
+			|| getInt(fp, &rows) != 0 || getInt(fp, &cols) != 0
+			|| getInt(fp, &state->canvas.anchorY) != 0 || getInt(fp, &state->canvas.anchorX) != 0
+			|| rows <= 0 || cols <= 0 || rows > 10000 || cols > 10000)
+		return -1;
+
+	state->seed = (int) (uint32_t) seed;
+	state->canvas.rows = rows;
+	state->canvas.cols = cols;
+	return 0;
+}
+
+// whether a record keeps the ith cell: one that differs from the grown ones,
+// or any that is not empty when grown is NULL
+int recordedCell(const struct growth *state, const struct cbonsaiCell *grown, size_t i) {
+	const struct cbonsaiCell *cell = &state->canvas.cells[i];
+	return grown ? memcmp(cell, &grown[i], sizeof(*cell)) != 0 : !emptyCell(cell);
+}
+
+// the cells of a record, and the bytes it takes
+uint32_t growthRecordSize(const struct growth *state, const struct cbonsaiCell *grown, long *bytes) {
+	size_t size = (size_t) state->canvas.rows * state->canvas.cols;
+	uint32_t cells = 0;
+	*bytes = GROWTH_RECORD_SIZE + state->tips.count * GROWTH_TIP_SIZE;
+	for (size_t i = 0; i < size; i++) {
+		if (!recordedCell(state, grown, i)) continue;
+		cells++;
+		*bytes += GROWTH_CELL_SIZE + strlen(state->canvas.cells[i].glyph);
+	}
+	return cells;
+}
+
+void putGrowthRecord(FILE *fp, const struct growth *state, const struct cbonsaiCell *grown) {
+	const struct cbonsaiCanvas *canvas = &state->canvas;
+	size_t size = (size_t) canvas->rows * canvas->cols;
+	long bytes;
+	uint32_t changed = growthRecordSize(state, grown, &bytes);
+
+	putNumber(fp, bytes - 4, 4);
+	putNumber(fp, (uint32_t) state->stats.steps, 4);
+	putNumber(fp, (uint32_t) state->stats.branches, 4);
+	putNumber(fp, (uint32_t) state->stats.shoots, 4);
+	putNumber(fp, changed, 4);
+	for (size_t i = 0; i < size; i++) {
+		const struct cbonsaiCell *cell = &canvas->cells[i];
+		if (!recordedCell(state, grown, i)) continue;
+
+		size_t len = strlen(cell->glyph);
+		putNumber(fp, i / canvas->cols, 2);
+		putNumber(fp, i % canvas->cols, 2);
+		putNumber(fp, cell->width, 1);
+		putNumber(fp, cell->attr, 1);
+		putNumber(fp, cell->type, 1);
+		putNumber(fp, len, 1);
+		fwrite(cell->glyph, 1, len, fp);
+	}
+
+	putNumber(fp, state->tips.count, 4);
+	for (const struct cbonsaiTip *tip = state->tips.first; tip; tip = tip->next) {
+		putNumber(fp, (uint32_t) tip->id, 4);
+		putNumber(fp, (uint32_t) tip->y, 4);
+		putNumber(fp, (uint32_t) tip->x, 4);
+		putNumber(fp, (uint32_t) tip->life, 4);
+		putNumber(fp, (uint32_t) tip->depth, 4);
+		putNumber(fp, (uint32_t) tip->dx, 4);
+		putNumber(fp, (uint32_t) tip->dy, 4);
+		putNumber(fp, (uint32_t) tip->shootCooldown, 4);
+		putNumber(fp, tip->spawned, 4);
+		putNumber(fp, tip->rng, 8);
+		putNumber(fp, tip->shootCounter, 4);
+		putNumber(fp, tip->type, 1);
+	}
+}
+
+// read the cells of a record into the canvas, skipping its tips. returns
+// where its tips start, or -1 if the record is cut short
+long getGrowthRecord(FILE *fp, long size, struct growth *state) {
+	struct cbonsaiCanvas *canvas = &state->canvas;
+	uint64_t bytes, count, y, x, width, attr, type, len, tips;
+	if (getNumber(fp, &bytes, 4) != 0 || bytes > (uint64_t) (size - ftell(fp))
+			|| getInt(fp, &state->stats.steps) != 0 || getInt(fp, &state->stats.branches) != 0
+			|| getInt(fp, &state->stats.shoots) != 0 || getNumber(fp, &count, 4) != 0)
+		return -1;
+
+	for (uint64_t i = 0; i < count; i++) {
+		if (getNumber(fp, &y, 2) != 0 || getNumber(fp, &x, 2) != 0 || getNumber(fp, &width, 1) != 0
+				|| getNumber(fp, &attr, 1) != 0 || getNumber(fp, &type, 1) != 0 || getNumber(fp, &len, 1) != 0
+				|| (int) y >= canvas->rows || (int) x >= canvas->cols || len >= sizeof(canvas->cells->glyph))
+			return -1;
+
+		struct cbonsaiCell *cell = &canvas->cells[y * canvas->cols + x];
+		memset(cell, 0, sizeof(*cell));
+		if (fread(cell->glyph, 1, len, fp) != len) return -1;
+		cell->width = width;
+		cell->attr = attr;
+		cell->type = type;
+	}
+
+	long start = ftell(fp);
+	if (getNumber(fp, &tips, 4) != 0 || fseek(fp, tips * GROWTH_TIP_SIZE, SEEK_CUR) != 0)
+		return -1;
+	return start;
+}
+
+int getGrowthTips(FILE *fp, struct growth *state) {
+	uint64_t count;
+	if (getNumber(fp, &count, 4) != 0) return -1;
+
+	for (uint64_t i = 0; i < count; i++) {
+		struct cbonsaiTip tip = {0};
+		uint64_t spawned, rng, shootCounter, type;
+		if (getInt(fp, &tip.id) != 0 || getInt(fp, &tip.y) != 0 || getInt(fp, &tip.x) != 0
+				|| getInt(fp, &tip.life) != 0 || getInt(fp, &tip.depth) != 0
+				|| getInt(fp, &tip.dx) != 0 || getInt(fp, &tip.dy) != 0 || getInt(fp, &tip.shootCooldown) != 0
+				|| getNumber(fp, &spawned, 4) != 0 || getNumber(fp, &rng, 8) != 0
+				|| getNumber(fp, &shootCounter, 4) != 0 || getNumber(fp, &type, 1) != 0 || type >= cbonsaiNoBranch)
+			return -1;
+
+		tip.spawned = spawned;
+		tip.rng = rng;
+		tip.shootCounter = shootCounter;
+		tip.type = type;
+		if (cbonsaiTipsAdd(&state->tips, &tip) != 0) return -1;
+	}
+	return 0;
+}
+
+// load a growth file, or start a new tree if it is empty
+int loadGrowth(const struct config *conf, FILE *fp, struct growth *state) {
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	rewind(fp);
+
+	int rows, cols;
+	int planted = getGrowthHeader(fp, state) == 0;
+	if (!planted) {
+		if (size != 0) return -1;
+
+		state->seed = conf->seed;
+		state->lifeStart = conf->lifeStart;
+		state->multiplier = conf->multiplier;
+		canvasSize(conf, &rows, &cols);
+		state->canvas.rows = rows;
+		state->canvas.cols = cols;
+	}
+
+	rows = state->canvas.rows;
+	cols = state->canvas.cols;
+	state->canvas.cells = calloc((size_t) rows * cols, sizeof(struct cbonsaiCell));
+	state->grown = malloc((size_t) rows * cols * sizeof(struct cbonsaiCell));
+	if (!state->canvas.cells || !state->grown) return -1;
+
+	if (!planted) {
+		anchorCanvas(conf, &state->canvas);
+		state->end = 0;
+		return 0;
+	}
+
+	// a record cut short, by a run that was killed, is left out
+	long tips = -1;
+	state->end = ftell(fp);
+	for (long start; (start = getGrowthRecord(fp, size, state)) >= 0; state->end = ftell(fp))
+		tips = start;
+	if (tips < 0 || fseek(fp, tips, SEEK_SET) != 0) return -1;
+	state->canvas.palette = &conf->palette;
+	return getGrowthTips(fp, state);
+}
+
+// add a record of this run, or rewrite the file as one record once the
+// records take twice as much. returns -1 on write errors
+int saveGrowth(const char *fname, FILE *fp, const struct growth *state) {
+	long whole, record;
+	growthRecordSize(state, NULL, &whole);
+	growthRecordSize(state, state->grown, &record);
+	whole += GROWTH_HEADER_SIZE;
+
+	if (state->end > 0 && state->end + record <= 2 * whole) {
+		if (fflush(fp) != 0 || ftruncate(fileno(fp), state->end) != 0 || fseek(fp, state->end, SEEK_SET) != 0)
+			return -1;
+		putGrowthRecord(fp, state, state->grown);
+		return fflush(fp) == 0 && fsync(fileno(fp)) == 0 ? 0 : -1;
+	}
+
+	// a new file replaces the old one at once, so it is never seen half
+	// written. it gets a name of its own next to the old one, so runs that
+	// rewrite at once cannot write into each other's, and the permissions
+	// openGrowth() would have given it
+	size_t tmpLen = strlen(fname) + 8;
+	char tmpName[tmpLen];
+	snprintf(tmpName, tmpLen, "%s.XXXXXX", fname);
+
+	FILE *out = NULL;
+	int fd = mkstemp(tmpName);
+	if (fd < 0) return -1;
+	mode_t mask = umask(0);
+	umask(mask);
+	if (fchmod(fd, 0644 & ~mask) != 0 || !(out = fdopen(fd, "w"))) {
+		close(fd);
+		remove(tmpName);
+		return -1;
+	}
+
+	putGrowthHeader(out, state);
+	putGrowthRecord(out, state, NULL);
+	int failed = fflush(out) != 0 || fsync(fileno(out)) != 0;
+	if (fclose(out) != 0 || failed || rename(tmpName, fname) != 0) {
+		remove(tmpName);
+		return -1;
+	}
+	return 0;
+}
+
+// open and lock a growth file. the lock is taken on whatever the name points
+// to, which another run may have just replaced while this one was waiting
+FILE* openGrowth(const char *fname) {
+	for (;;) {
+		int fd = open(fname, O_RDWR | O_CREAT, 0644);
+		if (fd < 0) return NULL;
+
+		struct stat locked, named;
+		if (flock(fd, LOCK_EX) != 0 || fstat(fd, &locked) != 0) {
+			close(fd);
+			return NULL;
+		}
+		if (stat(fname, &named) == 0 && named.st_ino == locked.st_ino && named.st_dev == locked.st_dev)
+			return fdopen(fd, "r+");
+		close(fd);
+	}
+}
+
+// grow the tree of a growth file a little further, save it, and print it
+int keepGrowing(const struct config *conf) {
+	const char *fname = conf->growthFile;
+	FILE *fp = openGrowth(fname);
+	if (!fp) {
+		printf("error: file was not opened properly for writing: %s\n", fname);
+		return 1;
+	}
+
+	struct growth state;
+	memset(&state, 0, sizeof(state));
+	cbonsaiArenaInit(&state.arena, NULL, 0);
+	state.arena.grow = malloc;
+	cbonsaiTipsInit(&state.tips, &state.arena);
+
+	int failed = 0;
+	if (loadGrowth(conf, fp, &state) != 0) {
+		printf("error: not a growing tree, or one that could not be loaded: '%s'\n", fname);
+		failed = 1;
+	}
+
+	if (!failed) {
+		memcpy(state.grown, state.canvas.cells, (size_t) state.canvas.rows * state.canvas.cols * sizeof(*state.grown));
+
+		// the tree keeps the seed, life and multiplier it was planted with,
+		// and grows without budgets, as growth is limited by installments
+		struct cbonsaiConfig treeConf = treeConfig(conf);
+		treeConf.seed = state.seed;
+		treeConf.lifeStart = state.lifeStart;
+		treeConf.multiplier = state.multiplier;
+		treeConf.maxSteps = 0;
+		treeConf.maxBranches = 0;
+		treeConf.timeLimit = 0;
+
+		struct cbonsaiTree tree;
+		memset(&tree, 0, sizeof(tree));
+		tree.conf = &treeConf;
+		tree.onPaint = paintGrowth;
+		tree.userData = &state.canvas;
+		tree.stats = state.stats;
+
+		if (state.end == 0) failed = cbonsaiTipsPlant(&tree, &state.tips) != 0;
+		if (!failed) failed = cbonsaiGrowTips(&tree, &state.tips, conf->growLife, conf->growSteps) != 0;
+
+		// a tree that has finished growing is left as it is
+		int grew = state.end == 0 || tree.stats.steps != state.stats.steps;
+		state.stats = tree.stats;
+
+		if (!failed && grew && saveGrowth(fname, fp, &state) != 0) {
+			printf("error: could not save growing tree to '%s'\n", fname);
+			failed = 1;
+		}
+	}
+	fclose(fp);
+
+	if (!failed) {
+		paintSurroundings(conf, &state.canvas);
+		failed = writeFormat(&state.canvas, conf->format, stdout) != 0;
+		if (conf->verbosity)
+			printf("steps: %d, branches: %d, still growing: %zu\n", state.stats.steps, state.stats.branches, state.tips.count);
+		failed |= fflush(stdout) != 0;
+	}
+
+	free(state.canvas.cells);
+	free(state.grown);
+	cbonsaiArenaRelease(&state.arena, free);
+	return failed;
+}
+
+/* ring files of pre-rendered trees, made by --pregen and read by --next */
+
+#define RING_MAGIC "cbonsai"
+
+struct ringHeader {
+	char magic[8];
+	uint32_t count;
+	_Atomic uint32_t cursor;	// the next tree to hand out
+	uint64_t offsets[];	// where each tree starts, then where the last one ends
+};
+
+// render every nth tree of a ring into part, followed by the size of each
+int renderRingPart(const struct config *conf, int first, int step, int count, FILE *part) {
+	int rows, cols;
+	canvasSize(conf, &rows, &cols);
+
+	struct cbonsaiCanvas canvas;
+	struct cbonsaiCell *cells = malloc((size_t) rows * cols * sizeof(*cells));
+	uint64_t *sizes = malloc((count + step - 1) / step * sizeof(*sizes));
+	if (!cells || !sizes) return 1;
+	cbonsaiCanvasInit(&canvas, cells, rows, cols);
+
+	// a part that failed halfway is not finished with its sizes, and the
+	// exit status tells the parent to give up on the ring
+	int n = 0;
+	int failed = 0;
+	for (int i = first; !failed && i < count; i += step) {
+		long start = ftell(part);
+		growCanvas(conf, &canvas, conf->seed + i, NULL);
+		long end = (start < 0 || writeFormat(&canvas, conf->format, part) != 0) ? -1 : ftell(part);
+		if (end < 0) failed = 1;
+		else sizes[n++] = end - start;
+	}
+
+	if (!failed && fwrite(sizes, sizeof(*sizes), n, part) != (size_t) n)
+		failed = 1;
+	free(cells);
+	free(sizes);
+	return (failed || fflush(part) != 0 || ferror(part)) ? 1 : 0;
+}
+
+// copy size bytes from one file to another
+int copyBytes(FILE *from, FILE *to, uint64_t size) {
+	char buf[BUFSIZ];
+	while (size > 0) {
+		size_t len = size < sizeof(buf) ? size : sizeof(buf);
+		if (fread(buf, 1, len, from) != len || fwrite(buf, 1, len, to) != len)
+			return 1;
+		size -= len;
+	}
+	return 0;
+}
+
+// render trees into a ring file, one worker process per cpu. the file is
+// replaced at once, so --next keeps working while a ring is regenerated
+int pregenerate(const struct config *conf) {
+	int count = conf->pregenCount;
+	int workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (workers < 1) workers = 1;
+	if (workers > count) workers = count;
+
+	FILE *parts[workers];
+	pid_t pids[workers];
+	int failed = 0;
+
+	fflush(stdout);
+	for (int w = 0; w < workers; w++) {
+		parts[w] = tmpfile();
+		pids[w] = parts[w] ? fork() : -1;
+		if (pids[w] == 0) _exit(renderRingPart(conf, w, workers, count, parts[w]));
+		if (pids[w] < 0) failed = 1;
+	}
+
+	for (int w = 0; w < workers; w++) {
+		int status;
+		if (pids[w] > 0 && (waitpid(pids[w], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0))
+			failed = 1;
+	}
+
+	// collect the size of each tree from the end of its part. the trees
+	// have to add up to what comes before the sizes, or the part is short
+	uint64_t *offsets = calloc(count + 1, sizeof(*offsets));
+	uint64_t *sizes = malloc((count + workers - 1) / workers * sizeof(*sizes));
+	if (!offsets || !sizes) failed = 1;
+	for (int w = 0; !failed && w < workers; w++) {
+		int n = (count - w + workers - 1) / workers;
+		uint64_t trees = 0;
+
+		long table = fseek(parts[w], -(long) (n * sizeof(*sizes)), SEEK_END) != 0 ? -1 : ftell(parts[w]);
+		if (table < 0 || fread(sizes, sizeof(*sizes), n, parts[w]) != (size_t) n)
+			failed = 1;
+		for (int i = 0; !failed && i < n; i++) {
+			offsets[w + i * workers + 1] = sizes[i];
+			trees += sizes[i];
+		}
+		if (!failed && trees != (uint64_t) table)
+			failed = 1;
+		rewind(parts[w]);
+	}
+	free(sizes);
+
+	if (!failed) {
+		offsets[0] = sizeof(struct ringHeader) + (count + 1) * sizeof(*offsets);
+		for (int i = 1; i <= count; i++)
+			offsets[i] += offsets[i - 1];
+	}
+
+	// write the ring next to the old one, under a name of its own so that
+	// runs at the same time do not write into each other's, then move it
+	// into place. mkstemp() leaves it to the owner, but --next has to open
+	// the ring for writing, so it gets the usual permissions
+	size_t tmpLen = strlen(conf->pregenFile) + 8;
+	char tmpName[tmpLen];
+	snprintf(tmpName, tmpLen, "%s.XXXXXX", conf->pregenFile);
+
+	FILE *ring = NULL;
+	int fd = failed ? -1 : mkstemp(tmpName);
+	if (fd >= 0) {
+		mode_t mask = umask(0);
+		umask(mask);
+		if (fchmod(fd, 0666 & ~mask) != 0 || !(ring = fdopen(fd, "wb"))) {
+			close(fd);
+			remove(tmpName);
+		}
+	}
+	if (ring) {
+		struct ringHeader header = { RING_MAGIC, count, 0 };
+		fwrite(&header, sizeof(header), 1, ring);
+		fwrite(offsets, sizeof(*offsets), count + 1, ring);
+
+		for (int i = 0; i < count; i++) {
+			if (copyBytes(parts[i % workers], ring, offsets[i + 1] - offsets[i]) != 0) {
+				failed = 1;
+				break;
+			}
+		}
+
+		if (fclose(ring) != 0 || failed || rename(tmpName, conf->pregenFile) != 0) {
+			failed = 1;
+			remove(tmpName);
+		}
+	} else failed = 1;
+
+	for (int w = 0; w < workers; w++)
+		if (parts[w]) fclose(parts[w]);
+	free(offsets);
+
+	if (failed) {
+		printf("error: could not pre-generate trees into '%s'\n", conf->pregenFile);
+		return 1;
+	}
+	return 0;
+}
+
+// print the next tree of a ring and move its cursor, safely shared with any
+// other --next running at the same time
+int printNext(const char *fname) {
+	int fd = open(fname, O_RDWR);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(struct ringHeader)) {
+		printf("error: could not read ring of trees from '%s'\n", fname);
+		if (fd >= 0) close(fd);
+		return 1;
+	}
+
+	size_t size = st.st_size;
+	struct ringHeader *ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED || memcmp(ring->magic, RING_MAGIC, sizeof(ring->magic)) != 0 || ring->count == 0
+			|| (size - sizeof(*ring)) / sizeof(uint64_t) <= ring->count) {
+		printf("error: not a ring of trees: '%s'\n", fname);
+		if (ring != MAP_FAILED) munmap(ring, size);
+		return 1;
+	}
+
+	uint32_t index = atomic_fetch_add(&ring->cursor, 1) % ring->count;
+	uint64_t start = ring->offsets[index];
+	uint64_t end = ring->offsets[index + 1];
+	if (start > end || end > size) {
+		printf("error: not a ring of trees: '%s'\n", fname);
+		munmap(ring, size);
+		return 1;
+	}
+
+	const char *tree = (const char *) ring + start;
+	while (start < end) {
+		ssize_t written = write(STDOUT_FILENO, tree, end - start);
+		if (written < 0 && errno == EINTR) continue;
+		if (written <= 0) break;
+		tree += written;
+		start += written;
+	}
+
+	munmap(ring, size);
+	return start == end ? 0 : 1;
+}
+
+/* tree server, for --serve */
+
+#define SERVER_POOL_SIZE 16	// trees grown ahead for each set of parameters
+#define SERVER_POOLS 8		// sets of parameters with a pool
+#define SERVER_CACHE_SIZE 128	// trees kept for requests by seed
+#define SERVER_MAX_LINE 512
+#define SERVER_MAX_SIZE 1000	// rows or columns of a requested tree
+#define SERVER_MAX_QUEUE (1 << 20)	// bytes of replies a client may leave unread
+
+// what a client asks for
+struct treeRequest {
+	unsigned long seed;	// 0 for any tree
+	int rows;
+	int cols;
+	int lifeStart;
+	int multiplier;
+	enum outputFormat format;
+};
+
+struct renderedTree {
+	struct treeRequest key;
+	char* data;
+	size_t size;
+	unsigned long lastUsed;
+};
+
+// trees grown ahead of demand for requests without a seed
+struct treePool {
+	struct treeRequest key;
+	struct renderedTree trees[SERVER_POOL_SIZE];
+	int count;
+	unsigned long lastUsed;
+};
+
+struct client {
+	int fd;
+	char in[SERVER_MAX_LINE];
+	size_t inLen;
+
+	// replies not yet taken by the socket
+	char* out;
+	size_t outLen;
+	size_t outSent;
+	size_t outCap;
+	uint32_t events;	// what epoll waits for: input, unless too many replies
+				// are unread, and whether the socket takes more output
+};
+
+struct server {
+	const struct config *conf;
+	struct treeRequest defaults;
+	int listenFd;
+	int epollFd;
+	int clients;
+
+	struct cbonsaiCanvas canvas;
+	size_t canvasSize;
+	unsigned long nextSeed;
+	unsigned long clock;	// ticks on every use of the cache or a pool, for LRU
+
+	struct renderedTree cache[SERVER_CACHE_SIZE];
+	int cacheCount;
+	struct treePool pools[SERVER_POOLS];
+	int poolCount;
+
+	// statistics
+	struct timespec started;
+	unsigned long requests;
+	unsigned long errors;
+	unsigned long poolHits;
+	unsigned long cacheHits;
+	unsigned long misses;
+	double latencyTotal;	// in microseconds
+	double latencyMax;
+	unsigned long latencies[32];	// by power of two microseconds
+};
+
+volatile sig_atomic_t stopServer = 0;
+
+void onStopSignal(int sig) {
+	(void) sig;
+	stopServer = 1;
+}
+
+int sameTrees(const struct treeRequest *a, const struct treeRequest *b) {
+	return a->seed == b->seed && a->rows == b->rows && a->cols == b->cols
+		&& a->lifeStart == b->lifeStart && a->multiplier == b->multiplier && a->format == b->format;
+}
+
+int renderTree(struct server *server, const struct treeRequest *request, unsigned long seed, struct renderedTree *tree) {
+	size_t size = (size_t) request->rows * request->cols;
+	if (size > server->canvasSize) {
+		struct cbonsaiCell *cells = realloc(server->canvas.cells, size * sizeof(*cells));
+		if (!cells) return -1;
+		server->canvas.cells = cells;
+		server->canvasSize = size;
+	}
+	cbonsaiCanvasInit(&server->canvas, server->canvas.cells, request->rows, request->cols);
+
+	struct config conf = *server->conf;
+	conf.lifeStart = request->lifeStart;
+	conf.multiplier = request->multiplier;
+	growCanvas(&conf, &server->canvas, seed, NULL);
+
+	tree->key = *request;
+	tree->key.seed = seed;
+	tree->data = NULL;
+	tree->size = 0;
+
+	FILE *fp = open_memstream(&tree->data, &tree->size);
+	if (!fp) return -1;
+	int failed = writeFormat(&server->canvas, request->format, fp);
+	if (fclose(fp) != 0 || failed) {
+		free(tree->data);
+		tree->data = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+struct renderedTree* cacheFind(struct server *server, const struct treeRequest *request) {
+	for (int i = 0; i < server->cacheCount; i++) {
+		if (sameTrees(&server->cache[i].key, request)) {
+			server->cache[i].lastUsed = ++server->clock;
+			return &server->cache[i];
+		}
+	}
+	return NULL;
+}
+
+// keep a tree, in place of the least recently used one when the cache is full
+struct renderedTree* cacheAdd(struct server *server, const struct renderedTree *tree) {
+	struct renderedTree *slot = &server->cache[server->cacheCount];
+
+	if (server->cacheCount == SERVER_CACHE_SIZE) {
+		slot = &server->cache[0];
+		for (int i = 1; i < SERVER_CACHE_SIZE; i++) {
+			if (server->cache[i].lastUsed < slot->lastUsed)
+				slot = &server->cache[i];
+		}
+		free(slot->data);
+	} else server->cacheCount++;
+
+	*slot = *tree;
+	slot->lastUsed = ++server->clock;
+	return slot;
+}
+
+// find the pool for a set of parameters, or make one in place of the least
+// recently used pool
+struct treePool* poolFind(struct server *server, const struct treeRequest *request) {
+	struct treeRequest key = *request;
+	key.seed = 0;
+
+	struct treePool *pool = NULL;
+	for (int i = 0; i < server->poolCount; i++) {
+		if (sameTrees(&server->pools[i].key, &key)) {
+			pool = &server->pools[i];
+			break;
+		}
+	}
+
+	if (!pool) {
+		pool = &server->pools[server->poolCount];
+		if (server->poolCount == SERVER_POOLS) {
+			pool = &server->pools[0];
+			for (int i = 1; i < SERVER_POOLS; i++) {
+				if (server->pools[i].lastUsed < pool->lastUsed)
+					pool = &server->pools[i];
+			}
+			for (int i = 0; i < pool->count; i++)
+				free(pool->trees[i].data);
+		} else server->poolCount++;
+
+		pool->key = key;
+		pool->count = 0;
+	}
+
+	pool->lastUsed = ++server->clock;
+	return pool;
+}
+
+// grow a tree for the first pool that is not full. returns 0 if all are full
+int refillPool(struct server *server) {
+	for (int i = 0; i < server->poolCount; i++) {
+		struct treePool *pool = &server->pools[i];
+		if (pool->count == SERVER_POOL_SIZE) continue;
+
+		if (renderTree(server, &pool->key, server->nextSeed++, &pool->trees[pool->count]) == 0)
+			pool->count++;
+		return 1;
+	}
+	return 0;
+}
+
+// add a reply to the output of a client
+int queueReply(struct client *client, const char *header, const char *data, size_t size) {
+	size_t headerLen = strlen(header);
+	size_t needed = client->outLen + headerLen + size;
+
+	if (needed > client->outCap) {
+		size_t cap = client->outCap ? client->outCap : 4096;
+		while (cap < needed) cap *= 2;
+		char *out = realloc(client->out, cap);
+		if (!out) return -1;
+		client->out = out;
+		client->outCap = cap;
+	}
+
+	memcpy(client->out + client->outLen, header, headerLen);
+	memcpy(client->out + client->outLen + headerLen, data, size);
+	client->outLen = needed;
+	return 0;
+}
+
+int replyError(struct server *server, struct client *client, const char *message) {
+	char header[SERVER_MAX_LINE + 64];
+	snprintf(header, sizeof(header), "error %s\n", message);
+	server->errors++;
+	return queueReply(client, header, "", 0);
+}
+
+int replyTree(struct client *client, const struct renderedTree *tree) {
+	char header[64];
+	snprintf(header, sizeof(header), "ok %lu %zu\n", tree->key.seed, tree->size);
+	return queueReply(client, header, tree->data, tree->size);
+}
+
+// an upper bound of the given share of latencies, in microseconds
+unsigned long latencyPercentile(const struct server *server, double share) {
+	unsigned long seen = 0;
+	for (int i = 0; i < 32; i++) {
+		seen += server->latencies[i];
+		if (seen >= share * server->requests) return 1UL << i;
+	}
+	return 1UL << 31;
+}
+
+int replyStats(struct server *server, struct client *client) {
+	double uptime = secondsSince(&server->started);
+	double average = server->requests ? server->latencyTotal / server->requests : 0;
+
+	char text[1024];
+	int len = snprintf(text, sizeof(text),
+		"uptime: %.0f s\n"
+		"clients: %d\n"
+		"requests: %lu (%.1f per second)\n"
+		"errors: %lu\n"
+		"pool hits: %lu\n"
+		"cache hits: %lu\n"
+		"misses: %lu\n"
+		"latency: avg %.0f us, p50 < %lu us, p99 < %lu us, max %.0f us\n",
+		uptime, server->clients,
+		server->requests, uptime > 0 ? server->requests / uptime : 0,
+		server->errors, server->poolHits, server->cacheHits, server->misses,
+		average, latencyPercentile(server, 0.5), latencyPercentile(server, 0.99), server->latencyMax);
+
+	char header[64];
+	snprintf(header, sizeof(header), "ok 0 %d\n", len);
+	return queueReply(client, header, text, len);
+}
+
+// a seed of a request: digits only, so that e.g. -1 does not wrap around
+int parseSeed(const char *str, unsigned long *seed) {
+	char *end;
+	if (!isdigit((unsigned char) *str)) return -1;
+	errno = 0;
+	*seed = strtoul(str, &end, 10);
+	return errno || *end ? -1 : 0;
+}
+
+// parse a request like "seed=42 size=80x24 life=32 multiplier=5 format=ansi",
+// where every field is optional: an empty line asks for any tree
+int parseRequest(const struct server *server, char *line, struct treeRequest *request) {
+	*request = server->defaults;
+
+	for (char *token = strtok(line, " \t"); token; token = strtok(NULL, " \t")) {
+		if (!strncmp(token, "seed=", 5)) {
+			if (parseSeed(token + 5, &request->seed) != 0) return -1;
+			continue;
+		}
+		if (sscanf(token, "size=%dx%d", &request->cols, &request->rows) == 2) continue;
+		if (sscanf(token, "life=%d", &request->lifeStart) == 1) continue;
+		if (sscanf(token, "multiplier=%d", &request->multiplier) == 1) continue;
+		if (!strncmp(token, "format=", 7) && parseFormat(token + 7, &request->format) == 0) continue;
+		return -1;
+	}
+
+	if (request->rows < 1 || request->rows > SERVER_MAX_SIZE || request->cols < 1 || request->cols > SERVER_MAX_SIZE
+			|| request->lifeStart < 0 || request->lifeStart > 200 || request->multiplier < 0 || request->multiplier > 20)
+		return -1;
+	return 0;
+}
+
+int handleRequest(struct server *server, struct client *client, char *line) {
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (!strcmp(line, "stats")) return replyStats(server, client);
+
+	char original[SERVER_MAX_LINE];
+	snprintf(original, sizeof(original), "%s", line);
+
+	struct treeRequest request;
+	if (parseRequest(server, line, &request) != 0) {
+		char message[SERVER_MAX_LINE + 32];
+		snprintf(message, sizeof(message), "invalid request: '%s'", original);
+		return replyError(server, client, message);
+	}
+
+	// take the tree from the cache or a pool, or grow it now
+	struct renderedTree tree;
+	struct renderedTree *found = NULL;
+	if (request.seed) {
+		found = cacheFind(server, &request);
+		if (found) server->cacheHits++;
+	} else {
+		struct treePool *pool = poolFind(server, &request);
+		if (pool->count > 0) {
+			found = cacheAdd(server, &pool->trees[--pool->count]);
+			server->poolHits++;
+		}
+	}
+
+	if (!found) {
+		server->misses++;
+		if (renderTree(server, &request, request.seed ? request.seed : server->nextSeed++, &tree) != 0)
+			return replyError(server, client, "could not grow tree");
+		found = cacheAdd(server, &tree);
+	}
+
+	if (replyTree(client, found) != 0) return -1;
+
+	double latency = secondsSince(&start) * 1e6;
+	int bucket = 0;
+	while (bucket < 31 && (1UL << bucket) <= latency) bucket++;
+	server->requests++;
+	server->latencies[bucket]++;
+	server->latencyTotal += latency;
+	if (latency > server->latencyMax) server->latencyMax = latency;
+	return 0;
+}
+
+void closeClient(struct server *server, struct client *client) {
+	epoll_ctl(server->epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+	close(client->fd);
+	free(client->out);
+	free(client);
+	server->clients--;
+}
+
+size_t unsentReplies(const struct client *client) {
+	return client->outLen - client->outSent;
+}
+
+// send what the socket takes, and wait for it to become writable for the
+// rest. a client that leaves too many replies unread is not read from until
+// it has taken them
+int flushClient(struct server *server, struct client *client) {
+	while (client->outSent < client->outLen) {
+		ssize_t sent = send(client->fd, client->out + client->outSent, client->outLen - client->outSent, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR) continue;
+		if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+		if (sent < 0) return -1;
+		client->outSent += sent;
+	}
+
+	if (!unsentReplies(client)) client->outSent = client->outLen = 0;
+
+	uint32_t events = (unsentReplies(client) < SERVER_MAX_QUEUE ? EPOLLIN : 0) | (unsentReplies(client) ? EPOLLOUT : 0);
+	if (events != client->events) {
+		struct epoll_event event = { .events = events, .data.ptr = client };
+		epoll_ctl(server->epollFd, EPOLL_CTL_MOD, client->fd, &event);
+		client->events = events;
+	}
+	return 0;
+}
+
+// answer the requests read so far, one per line, for as long as the client
+// takes its replies, keeping the rest for when it has
+int serveClient(struct server *server, struct client *client) {
+	for (;;) {
+		char *line = client->in;
+		char *end;
+		while (unsentReplies(client) < SERVER_MAX_QUEUE && (end = memchr(line, '\n', client->inLen - (line - client->in)))) {
+			*end = '\0';
+			if (end > line && end[-1] == '\r') end[-1] = '\0';
+			if (handleRequest(server, client, line) != 0) return -1;
+			line = end + 1;
+		}
+
+		// keep the start of the next request
+		client->inLen -= line - client->in;
+		memmove(client->in, line, client->inLen);
+
+		if (flushClient(server, client) != 0) return -1;
+		if (unsentReplies(client) >= SERVER_MAX_QUEUE || !memchr(client->in, '\n', client->inLen)) return 0;
+	}
+}
+
+int readClient(struct server *server, struct client *client) {
+	if (client->inLen < sizeof(client->in)) {
+		ssize_t got = recv(client->fd, client->in + client->inLen, sizeof(client->in) - client->inLen, 0);
+		if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return 0;
+		if (got <= 0) return -1;
+		client->inLen += got;
+	}
+
+	if (serveClient(server, client) != 0) return -1;
+	if (client->inLen == sizeof(client->in) && !memchr(client->in, '\n', client->inLen)) {
+		replyError(server, client, "request too long");
+		flushClient(server, client);
+		return -1;
+	}
+	return 0;
+}
+
+void acceptClients(struct server *server) {
+	int fd;
+	while ((fd = accept(server->listenFd, NULL, NULL)) >= 0) {
+		struct client *client = calloc(1, sizeof(*client));
+		struct epoll_event event = { .events = EPOLLIN, .data.ptr = client };
+
+		if (!client || fcntl(fd, F_SETFL, O_NONBLOCK) != 0 || epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+			free(client);
+			close(fd);
+			continue;
+		}
+		client->fd = fd;
+		client->events = EPOLLIN;
+		server->clients++;
+	}
+}
+
+int listenOn(struct server *server, const char *path) {
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+	strcpy(addr.sun_path, path);
+
+	// replace the socket of an earlier server, but nothing else
+	struct stat st;
+	if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+
+	server->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server->listenFd < 0) return -1;
+	if (bind(server->listenFd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+			|| listen(server->listenFd, SOMAXCONN) != 0
+			|| fcntl(server->listenFd, F_SETFL, O_NONBLOCK) != 0) {
+		close(server->listenFd);
+		return -1;
+	}
+
+	server->epollFd = epoll_create1(0);
+	struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+	if (server->epollFd < 0 || epoll_ctl(server->epollFd, EPOLL_CTL_ADD, server->listenFd, &event) != 0) {
+		close(server->listenFd);
+		unlink(path);
+		return -1;
+	}
+
+	return 0;
+}
+
+// serve trees until interrupted. all clients are handled by one epoll loop,
+// and pools are refilled whenever it is idle
+int serve(const struct config *conf) {
+	struct server server;
+	memset(&server, 0, sizeof(server));
+	server.conf = conf;
+	server.nextSeed = conf->seed;
+	clock_gettime(CLOCK_MONOTONIC, &server.started);
+
+	canvasSize(conf, &server.defaults.rows, &server.defaults.cols);
+	server.defaults.lifeStart = conf->lifeStart;
+	server.defaults.multiplier = conf->multiplier;
+	server.defaults.format = conf->format;
+
+	if (listenOn(&server, conf->serveSocket) != 0) {
+		printf("error: could not listen on '%s'\n", conf->serveSocket);
+		return 1;
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = onStopSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	// warm up the pool for the default parameters before taking requests
+	poolFind(&server, &server.defaults);
+	while (refillPool(&server));
+
+	if (conf->verbosity) {
+		printf("serving on %s\n", conf->serveSocket);
+		fflush(stdout);
+	}
+
+	struct epoll_event events[64];
+	int idle = 0;
+	while (!stopServer) {
+		int n = epoll_wait(server.epollFd, events, 64, idle ? -1 : 0);
+		if (n < 0 && errno == EINTR) continue;
+		if (n < 0) break;
+
+		// nothing to do but growing trees ahead
+		if (n == 0) {
+			idle = !refillPool(&server);
+			continue;
+		}
+
+		for (int i = 0; i < n; i++) {
+			struct client *client = events[i].data.ptr;
+			if (!client) {
+				acceptClients(&server);
+				continue;
+			}
+
+			int failed = (events[i].events & (EPOLLERR | EPOLLHUP)) && !(events[i].events & EPOLLIN);
+			if (!failed && (events[i].events & EPOLLIN)) failed = readClient(&server, client) != 0;
+			if (!failed && (events[i].events & EPOLLOUT)) failed = serveClient(&server, client) != 0;
+			if (failed) closeClient(&server, client);
+		}
+		idle = 0;
+	}
+
+	close(server.listenFd);
+	close(server.epollFd);
+	unlink(conf->serveSocket);
+
+	if (conf->verbosity)
+		printf("requests: %lu, pool hits: %lu, cache hits: %lu, misses: %lu\n", server.requests, server.poolHits, server.cacheHits, server.misses);
+
+	for (int i = 0; i < server.cacheCount; i++)
+		free(server.cache[i].data);
+	for (int i = 0; i < server.poolCount; i++)
+		for (int j = 0; j < server.pools[i].count; j++)
+			free(server.pools[i].trees[j].data);
+	free(server.canvas.cells);
+	return 0;
+}
+
+/* live growth on several outputs at once, for --fanout */
+
+#define FANOUT_MAX_QUEUE 65536	// bytes queued for a target before it skips ahead
+#define FANOUT_STALL 10		// seconds a target may take nothing before it is dropped
+
+// an output, with the part of the frames it has not taken yet
+struct fanoutTarget {
+	const char *path;
+	int fd;
+	char *queue;
+	size_t len;
+	size_t sent;
+	size_t cap;
+	int behind;	// frames were dropped, so it needs a full repaint
+	struct timespec lastWrite;
+};
+
+struct fanout {
+	const struct config *conf;
+	struct fanoutTarget targets[64];
+	int count;
+	struct cbonsaiCanvas canvas;
+
+	// the changes of the current step, shared by all targets
+	char *frame;
+	size_t frameSize;
+	FILE *frameFp;
+};
+
+volatile sig_atomic_t stopFanout = 0;
+
+void onFanoutSignal(int sig) {
+	(void) sig;
+	stopFanout = 1;
+}
+
+int openTarget(struct fanoutTarget *target, const char *path) {
+	struct stat st;
+	memset(target, 0, sizeof(*target));
+	target->path = path;
+	target->fd = -1;
+	clock_gettime(CLOCK_MONOTONIC, &target->lastWrite);
+
+	if (stat(path, &st) != 0) return -1;
+
+	if (S_ISSOCK(st.st_mode)) {
+		struct sockaddr_un addr = { .sun_family = AF_UNIX };
+		if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+		strcpy(addr.sun_path, path);
+
+		target->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (target->fd >= 0 && connect(target->fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+			close(target->fd);
+			target->fd = -1;
+		}
+		if (target->fd >= 0) fcntl(target->fd, F_SETFL, O_NONBLOCK);
+	} else target->fd = open(path, O_WRONLY | O_NOCTTY | O_NONBLOCK);
+
+	return target->fd < 0 ? -1 : 0;
+}
+
+void closeTarget(struct fanout *fan, struct fanoutTarget *target, const char *reason) {
+	if (fan->conf->verbosity) printf("%s: %s\n", target->path, reason);
+	close(target->fd);
+	free(target->queue);
+	*target = fan->targets[--fan->count];
+}
+
+void queueBytes(struct fanoutTarget *target, const char *data, size_t size) {
+	// drop what was already taken
+	if (target->sent == target->len) target->sent = target->len = 0;
+
+	if (target->len + size > target->cap) {
+		size_t cap = target->cap ? target->cap : 4096;
+		while (cap < target->len + size) cap *= 2;
+		char *queue = realloc(target->queue, cap);
+		if (!queue) {
+			target->behind = 1;
+			return;
+		}
+		target->queue = queue;
+		target->cap = cap;
+	}
+
+	memcpy(target->queue + target->len, data, size);
+	target->len += size;
+}
+
+// the whole canvas, after clearing the screen
+void queueRepaint(struct fanout *fan, struct fanoutTarget *target) {
+	char *data = NULL;
+	size_t size = 0;
+	FILE *fp = open_memstream(&data, &size);
+	if (!fp) return;
+
+	fputs("\033[0m\033[?25l\033[H\033[2J", fp);
+	for (int y = 0; y < fan->canvas.rows; y++) {
+		const struct cbonsaiCell *row = &fan->canvas.cells[(size_t) y * fan->canvas.cols];
+		int end = fan->canvas.cols;
+		while (end > 0 && !row[end - 1].glyph[0]) end--;
+		if (end > 0) cbonsaiCanvasWriteAnsiSpan(&fan->canvas, y, 0, end, fp);
+	}
+
+	if (fclose(fp) == 0) {
+		target->behind = 0;
+		queueBytes(target, data, size);
+	}
+	free(data);
+}
+
+// hand the changes of this step to every target. a target that cannot keep
+// up loses its queue and skips ahead to a full repaint once it catches up;
+// cutting a queue short may leave an escape sequence unfinished, but the
+// escape starting the repaint cancels it
+void queueFrame(struct fanout *fan) {
+	if (fflush(fan->frameFp) != 0) return;
+
+	for (int i = 0; i < fan->count; i++) {
+		struct fanoutTarget *target = &fan->targets[i];
+		if (target->behind) continue;
+
+		if (target->len - target->sent + fan->frameSize > FANOUT_MAX_QUEUE) {
+			target->behind = 1;
+			target->len = target->sent;
+			continue;
+		}
+		queueBytes(target, fan->frame, fan->frameSize);
+	}
+
+	rewind(fan->frameFp);
+}
+
+// write queued frames to the targets until the given time has passed
+void pumpTargets(struct fanout *fan, double seconds) {
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	do {
+		struct pollfd fds[64];
+		int waiting = 0;
+		for (int i = 0; i < fan->count; i++) {
+			struct fanoutTarget *target = &fan->targets[i];
+
+			// skip ahead once everything queued is taken
+			if (target->behind && target->sent == target->len)
+				queueRepaint(fan, target);
+
+			fds[i].fd = target->fd;
+			fds[i].events = target->sent < target->len ? POLLOUT : 0;
+			fds[i].revents = 0;
+			if (fds[i].events) waiting = 1;
+		}
+
+		double left = seconds - secondsSince(&start);
+		if (left < 0) left = 0;
+		if (poll(fds, fan->count, waiting ? left * 1000 : 0) < 0 && errno != EINTR) return;
+		if (!waiting) {
+			struct timespec ts = { (time_t) left, (left - (time_t) left) * 1e9 };
+			nanosleep(&ts, NULL);
+		}
+
+		// go backwards, as closing a target moves the last one into its place
+		for (int i = fan->count - 1; i >= 0; i--) {
+			struct fanoutTarget *target = &fan->targets[i];
+
+			if (fds[i].revents & POLLOUT) {
+				ssize_t written = write(target->fd, target->queue + target->sent, target->len - target->sent);
+				if (written > 0) {
+					target->sent += written;
+					clock_gettime(CLOCK_MONOTONIC, &target->lastWrite);
+				} else if (written < 0 && errno != EAGAIN && errno != EINTR) {
+					closeTarget(fan, target, "closed");
+					continue;
+				}
+			} else if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+				closeTarget(fan, target, "closed");
+				continue;
+			}
+
+			if (target->sent < target->len && secondsSince(&target->lastWrite) > FANOUT_STALL)
+				closeTarget(fan, target, "dropped, too slow");
+		}
+	} while (fan->count > 0 && !stopFanout && secondsSince(&start) < seconds);
+}
+
+int onFanoutStep(struct cbonsaiTree *tree) {
+	struct fanout *fan = tree->userData;
+	return stopFanout || fan->count == 0;
+}
+
+// paint a step, send it to every target, and wait for the next one
+void onFanoutPaint(struct cbonsaiTree *tree, const struct cbonsaiPaint *paint) {
+	struct fanout *fan = tree->userData;
+
+	cbonsaiCanvasPaint(&fan->canvas, paint);
+
+	int width = 0;
+	mbstate_t state;
+	memset(&state, 0, sizeof(state));
+	for (const char *str = paint->str; *str;) {
+		wchar_t wc;
+		size_t len = mbrtowc(&wc, str, MB_CUR_MAX, &state);
+		if (len == (size_t) -1 || len == (size_t) -2) break;
+		if (wcwidth(wc) > 0) width += wcwidth(wc);
+		str += len;
+	}
+
+	cbonsaiCanvasWriteAnsiSpan(&fan->canvas, fan->canvas.anchorY + paint->y, fan->canvas.anchorX + paint->x, width, fan->frameFp);
+	queueFrame(fan);
+	pumpTargets(fan, fan->conf->timeStep);
+}
+
+// grow trees once and show each step on every target, like --live
+int fanout(struct config *conf) {
+	struct fanout fan;
+	memset(&fan, 0, sizeof(fan));
+	fan.conf = conf;
+
+	// open each target, and size trees for the smallest terminal among them
+	int rows = 0, cols = 0;
+	for (char *path = strtok(conf->fanoutTargets, ","); path; path = strtok(NULL, ",")) {
+		if (fan.count == (int) (sizeof(fan.targets) / sizeof(fan.targets[0]))) break;
+
+		struct fanoutTarget *target = &fan.targets[fan.count];
+		if (openTarget(target, path) != 0) {
+			printf("error: could not open output: '%s'\n", path);
+			continue;
+		}
+		fan.count++;
+
+		struct winsize ws;
+		if (ioctl(target->fd, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col) {
+			if (!rows || ws.ws_row < rows) rows = ws.ws_row;
+			if (!cols || ws.ws_col < cols) cols = ws.ws_col;
+		}
+	}
+	if (fan.count == 0) return 1;
+
+	if (conf->geometryRows || !rows) canvasSize(conf, &rows, &cols);
+
+	struct cbonsaiCell *cells = malloc((size_t) rows * cols * sizeof(*cells));
+	fan.frameFp = open_memstream(&fan.frame, &fan.frameSize);
+	if (!cells || !fan.frameFp) return 1;
+	cbonsaiCanvasInit(&fan.canvas, cells, rows, cols);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = onFanoutSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	struct cbonsaiConfig treeConf = treeConfig(conf);
+	struct cbonsaiTree tree;
+	memset(&tree, 0, sizeof(tree));
+	tree.conf = &treeConf;
+	tree.onStep = onFanoutStep;
+	tree.onPaint = onFanoutPaint;
+	tree.userData = &fan;
+
+	do {
+		// start every target on a fresh screen with the base
+		cbonsaiCanvasClear(&fan.canvas);
+		anchorCanvas(conf, &fan.canvas);
+		cbonsaiCanvasPaintBase(&fan.canvas, conf->baseType);
+		for (int i = 0; i < fan.count; i++) {
+			fan.targets[i].len = fan.targets[i].sent;
+			queueRepaint(&fan, &fan.targets[i]);
+		}
+
+		treeConf.seed = conf->seed;
+		cbonsaiGrowTree(&tree);
+		pumpTargets(&fan, conf->infinite ? conf->timeWait : 0);
+
+		// seed the next tree
+		conf->seed = time(NULL);
+	} while (conf->infinite && fan.count > 0 && !stopFanout);
+
+	// leave each terminal with its cursor back, waiting briefly for it to
+	// take what is left
+	for (int i = 0; i < fan.count; i++) {
+		const char *reset = "\033[0m\033[?25h\n";
+		queueBytes(&fan.targets[i], reset, strlen(reset));
+	}
+	stopFanout = 0;
+	for (int tries = 0; tries < 10 && fan.count > 0; tries++) {
+		int pending = 0;
+		for (int i = 0; i < fan.count; i++)
+			if (fan.targets[i].sent < fan.targets[i].len) pending = 1;
+		if (!pending) break;
+		pumpTargets(&fan, 0.1);
+	}
+
+	while (fan.count > 0) {
+		fan.count--;
+		close(fan.targets[fan.count].fd);
+		free(fan.targets[fan.count].queue);
+	}
+	fclose(fan.frameFp);
+	free(fan.frame);
+	free(cells);
+	return 0;
+}
+
+char* createDefaultCachePath(void) {
+	char* result;
+	size_t envlen;
+	char* toAppend;
+
+	// follow XDG Base Directory Specification for default cache file path
+	const char* env_XDG_CACHE_HOME = getenv("XDG_CACHE_HOME");
+	if (env_XDG_CACHE_HOME && (envlen = strlen(env_XDG_CACHE_HOME))) {
+		toAppend = "/cbonsai";
+
+		// create result buffer
+		result = malloc(envlen + strlen(toAppend) + 1);
+		strncpy(result, env_XDG_CACHE_HOME, envlen);
+		strcpy(result + envlen, toAppend);
+		return result;
+	}
+
+	// if we don't have $XDG_CACHE_HOME, try $HOME
+	const char* env_HOME = getenv("HOME");
+	if (env_HOME && (envlen = strlen(env_HOME))) {
+		toAppend = "/.cache/cbonsai";
+
+		// create result buffer
+		result = malloc(envlen + strlen(toAppend) + 1);
+		strncpy(result, env_HOME, envlen);
+		strcpy(result + envlen, toAppend);
+		return result;
+	}
+
+	// if we also don't have $HOME, just use ./cbonsai
+	toAppend = "cbonsai";
+	result = malloc(strlen(toAppend) + 1);
+	strcpy(result, toAppend);
+	return result;
+}
+
+// read a whole file, which may be a pipe, into a string
+char* readFile(const char *fname) {
+	FILE *fp = fopen(fname, "r");
+	if (!fp) return NULL;
+
+	size_t size = 0, capacity = BUFSIZ;
+	char *text = malloc(capacity);
+	while (text) {
+		size += fread(text + size, 1, capacity - size - 1, fp);
+		if (size < capacity - 1) break;
+
+		capacity *= 2;
+		char *grown = realloc(text, capacity);
+		if (!grown) free(text);
+		text = grown;
+	}
+
+	if (text) text[size] = '\0';
+	if (ferror(fp)) {
+		free(text);
+		text = NULL;
+	}
+	fclose(fp);
+	return text;
+}
+
+// add the leaves of a list, separated by any of delim, each optionally
+// followed by =WEIGHT. the list is split in place. returns 1 if out of memory
+int addLeaves(struct config *conf, char *list, const char *delim) {
+	for (char *token = strtok(list, delim); token; token = strtok(NULL, delim)) {
+		double weight = 1;
+
+		// the weight is what follows the last '=', if it is a number
+		char *equals = strrchr(token, '=');
+		if (equals && equals != token && equals[1]) {
+			char *end;
+			double parsed = strtod(equals + 1, &end);
+			if (*end == '\0') {
+				*equals = '\0';
+				weight = parsed;
+			}
+		}
+
+		if (conf->leavesSize == conf->leavesCapacity) {
+			conf->leavesCapacity = conf->leavesCapacity ? conf->leavesCapacity * 2 : 64;
+			conf->leaves = realloc(conf->leaves, conf->leavesCapacity * sizeof(*conf->leaves));
+			conf->leafWeights = realloc(conf->leafWeights, conf->leavesCapacity * sizeof(*conf->leafWeights));
+			if (!conf->leaves || !conf->leafWeights) return 1;
+		}
+		conf->leaves[conf->leavesSize] = token;
+		conf->leafWeights[conf->leavesSize] = weight;
+		conf->leavesSize++;
+	}
+	return 0;
+}
+
+// gather the leaves of --leaf and --leaf-file, checking that each can be
+// drawn, and prepare them for choosing by weight
+int loadLeaves(struct config *conf) {
+	if (conf->leafFile) {
+		conf->leafText = readFile(conf->leafFile);
+		if (!conf->leafText) {
+			printf("error: leaf file could not be read: %s\n", conf->leafFile);
+			return 1;
+		}
+		if (addLeaves(conf, conf->leafText, "\r\n") != 0) {
+			printf("error: not enough memory for leaves\n");
+			return 1;
+		}
+	}
+
+	if (!conf->leafList && !conf->leafFile) conf->leafList = strdup("&");
+	if (conf->leafList && addLeaves(conf, conf->leafList, ",") != 0) {
+		printf("error: not enough memory for leaves\n");
+		return 1;
+	}
+	if (conf->leavesSize == 0) {
+		printf("error: no leaves given\n");
+		return 1;
+	}
+
+	for (int i = 0; i < conf->leavesSize; i++) {
+		if (cbonsaiGlyphWidth(conf->leaves[i]) < 0) {
+			printf("error: leaf cannot be drawn in this locale: '%s'\n", conf->leaves[i]);
+			return 1;
+		}
+		if (!(conf->leafWeights[i] >= 0)) {
+			printf("error: invalid leaf weight: '%s'\n", conf->leaves[i]);
+			return 1;
+		}
+	}
+
+	cbonsaiArenaInit(&conf->leafArena, NULL, 0);
+	conf->leafArena.grow = malloc;
+	if (cbonsaiLeafSetInit(&conf->leafSet, conf->leaves, conf->leafWeights, conf->leavesSize, &conf->leafArena) != 0) {
+		printf("error: leaves need a weight above 0\n");
+		return 1;
+	}
+	return 0;
+}
+
+// whether the terminal takes 24-bit colors, as far as it tells
+int truecolorTerminal(void) {
+	const char *colorterm = getenv("COLORTERM");
+	return colorterm && (!strcmp(colorterm, "truecolor") || !strcmp(colorterm, "24bit"));
+}
+
+// trees shown on terminals as they grow get 24-bit colors only where the
+// terminal says it takes them. everything else is written in 24-bit colors
+void fitTerminalPalette(struct config *conf) {
+	if (!truecolorTerminal()) conf->palette.colors = 256;
+}
+
+int main(int argc, char* argv[]) {
+	setlocale(LC_ALL, "");
+
+	struct config conf = {
+		.live = 0,
+		.infinite = 0,
+		.screensaver = 0,
+		.printTree = 0,
+		.verbosity = 0,
+		.lifeStart = 32,
+		.multiplier = 5,
+		.baseType = 1,
+		.seed = 0,
+		.leavesSize = 0,
+		.save = 0,
+		.load = 0,
+		.targetBranchCount = 0,
+		.maxSteps = 0,
+		.maxBranches = 0,
+		.ambientFps = 0,
+		.maxWakeups = 0,
+		.geometryRows = 0,
+		.geometryCols = 0,
+		.pregenCount = 0,
+		.threads = 0,
+		.growLife = 0,
+		.growSteps = 0,
+		.format = formatAnsi,
+
+		.timeWait = 4,
+		.timeStep = 0.03,
+		.timeLimit = 0,
+
+		.message = NULL,
+		.saveFile = createDefaultCachePath(),
+		.loadFile = createDefaultCachePath(),
+		.pregenFile = NULL,
+		.nextFile = NULL,
+		.serveSocket = NULL,
+		.fanoutTargets = NULL,
+		.exportFile = NULL,
+		.sceneFile = NULL,
+		.growthFile = NULL,
+	};
+	cbonsaiPaletteParse(&conf.palette, "classic");
+
+	struct option long_options[] = {
+		{"live", no_argument, NULL, 'l'},
+		{"time", required_argument, NULL, 't'},
+		{"infinite", no_argument, NULL, 'i'},
+		{"wait", required_argument, NULL, 'w'},
+		{"screensaver", no_argument, NULL, 'S'},
+		{"message", required_argument, NULL, 'm'},
+		{"base", required_argument, NULL, 'b'},
+		{"leaf", required_argument, NULL, 'c'},
+		{"multiplier", required_argument, NULL, 'M'},
+		{"life", required_argument, NULL, 'L'},
+		{"print", required_argument, NULL, 'p'},
+		{"seed", required_argument, NULL, 's'},
+		{"save", required_argument, NULL, 'W'},
+		{"load", required_argument, NULL, 'C'},
+		{"max-steps", required_argument, NULL, optMaxSteps},
+		{"max-branches", required_argument, NULL, optMaxBranches},
+		{"time-limit", required_argument, NULL, optTimeLimit},
+		{"ambient", optional_argument, NULL, optAmbient},
+		{"max-wakeups", required_argument, NULL, optMaxWakeups},
+		{"geometry", required_argument, NULL, optGeometry},
+		{"pregen", required_argument, NULL, optPregen},
+		{"next", required_argument, NULL, optNext},
+		{"serve", required_argument, NULL, optServe},
+		{"fanout", required_argument, NULL, optFanout},
+		{"format", required_argument, NULL, optFormat},
+		{"palette", required_argument, NULL, optPalette},
+		{"leaf-file", required_argument, NULL, optLeafFile},
+		{"threads", required_argument, NULL, optThreads},
+		{"export-scene", required_argument, NULL, optExportScene},
+		{"load-scene", required_argument, NULL, optLoadScene},
+		{"keep-growing", required_argument, NULL, optKeepGrowing},
+		{"grow-life", required_argument, NULL, optGrowLife},
+		{"grow-steps", required_argument, NULL, optGrowSteps},
+		{"verbose", no_argument, NULL, 'v'},
+		{"help", no_argument, NULL, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	struct ncursesObjects objects = {0};
+	struct scene scene = {0};
+	cbonsaiArenaInit(&scene.arena, NULL, 0);
+	scene.arena.grow = malloc;
+
+	// parse arguments
+	int option_index = 0;
+	int c;
+	while ((c = getopt_long(argc, argv, ":lt:iw:Sm:b:c:M:L:ps:C:W:vh", long_options, &option_index)) != -1) {
+		switch (c) {
+		case 'l':
+			conf.live = 1;
+			break;
+		case 't':
+			if (strtold(optarg, NULL) != 0) conf.timeStep = strtod(optarg, NULL);
+			else {
+				printf("error: invalid step time: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			if (conf.timeStep < 0) {
+				printf("error: invalid step time: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
 			}
 			break;
 		case 'i':
@@ -853,11 +3221,11 @@ int main(int argc, char* argv[]) {
 			if (strtold(optarg, NULL) != 0) conf.timeWait = strtod(optarg, NULL);
 			else {
 				printf("error: invalid wait time: '%s'\n", optarg);
-				quit(&conf, &objects, 1);
+				quit(&conf, &objects, &scene, 1);
 			}
 			if (conf.timeWait < 0) {
 				printf("error: invalid wait time: '%s'\n", optarg);
-				quit(&conf, &objects, 1);
+				quit(&conf, &objects, &scene, 1);
 			}
 			break;
 		case 'S':
@@ -882,33 +3250,33 @@ int main(int argc, char* argv[]) {
                         if (!errno) conf.baseType = strtod(optarg, NULL);
 			else {
 				printf("error: invalid base index: '%s'\n", optarg);
-				quit(&conf, &objects, 1);
+				quit(&conf, &objects, &scene, 1);
 			}
 			break;
 		case 'c':
-			strncpy(leavesInput, optarg, sizeof(leavesInput) - 1);
-			leavesInput[sizeof(leavesInput) - 1] = '\0';
+			free(conf.leafList);
+			conf.leafList = strdup(optarg);
 			break;
 		case 'M':
 			if (strtold(optarg, NULL) != 0) conf.multiplier = strtod(optarg, NULL);
 			else {
 				printf("error: invalid multiplier: '%s'\n", optarg);
-				quit(&conf, &objects, 1);
+				quit(&conf, &objects, &scene, 1);
 			}
 			if (conf.multiplier < 0) {
 				printf("error: invalid multiplier: '%s'\n", optarg);
-				quit(&conf, &objects, 1);
+				quit(&conf, &objects, &scene, 1);
 			}
 			break;
 		case 'L':
 			if (strtold(optarg, NULL) != 0) conf.lifeStart = strtod(optarg, NULL);
 			else {
 				printf("error: invalid initial life: '%s'\n", optarg);
-				quit(&conf, &objects, 1);
+				quit(&conf, &objects, &scene, 1);
 			}
 			if (conf.lifeStart < 0) {
 				printf("error: invalid initial life: '%s'\n", optarg);
-				quit(&conf, &objects, 1);
+				quit(&conf, &objects, &scene, 1);
 			}
 			break;
 		case 'p':
@@ -918,11 +3286,11 @@ int main(int argc, char* argv[]) {
 			if (strtold(optarg, NULL) != 0) conf.seed = strtod(optarg, NULL);
 			else {
 				printf("error: invalid seed: '%s'\n", optarg);
-				quit(&conf, &objects, 1);
+				quit(&conf, &objects, &scene, 1);
 			}
 			if (conf.seed < 0) {
 				printf("error: invalid seed: '%s'\n", optarg);
-				quit(&conf, &objects, 1);
+				quit(&conf, &objects, &scene, 1);
 			}
 			break;
 		case 'W':
@@ -951,6 +3319,136 @@ int main(int argc, char* argv[]) {
 
 			conf.load = 1;
 			break;
+		case optMaxSteps:
+			if (strtold(optarg, NULL) != 0) conf.maxSteps = strtod(optarg, NULL);
+			else {
+				printf("error: invalid step budget: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			if (conf.maxSteps < 0) {
+				printf("error: invalid step budget: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			break;
+		case optMaxBranches:
+			if (strtold(optarg, NULL) != 0) conf.maxBranches = strtod(optarg, NULL);
+			else {
+				printf("error: invalid branch budget: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			if (conf.maxBranches < 0) {
+				printf("error: invalid branch budget: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			break;
+		case optTimeLimit:
+			if (strtold(optarg, NULL) != 0) conf.timeLimit = strtod(optarg, NULL);
+			else {
+				printf("error: invalid time limit: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			if (conf.timeLimit < 0) {
+				printf("error: invalid time limit: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			break;
+		case optAmbient:
+			conf.ambientFps = 4;
+			if (optarg) {
+				if (strtold(optarg, NULL) != 0) conf.ambientFps = strtod(optarg, NULL);
+				else {
+					printf("error: invalid ambient frame rate: '%s'\n", optarg);
+					quit(&conf, &objects, &scene, 1);
+				}
+				if (conf.ambientFps <= 0 || conf.ambientFps > 1000) {
+					printf("error: invalid ambient frame rate: '%s'\n", optarg);
+					quit(&conf, &objects, &scene, 1);
+				}
+			}
+			break;
+		case optMaxWakeups:
+			if (strtold(optarg, NULL) != 0) conf.maxWakeups = strtod(optarg, NULL);
+			else {
+				printf("error: invalid wakeup cap: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			if (conf.maxWakeups < 0) {
+				printf("error: invalid wakeup cap: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			break;
+		case optGeometry:
+			if (sscanf(optarg, "%dx%d", &conf.geometryCols, &conf.geometryRows) != 2 || conf.geometryCols <= 0 || conf.geometryRows <= 0) {
+				printf("error: invalid geometry: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			break;
+		case optPregen:
+			if (strtold(optarg, NULL) != 0) conf.pregenCount = strtod(optarg, NULL);
+			else {
+				printf("error: invalid number of trees: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			if (conf.pregenCount < 0) {
+				printf("error: invalid number of trees: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			break;
+		case optNext:
+			conf.nextFile = optarg;
+			break;
+		case optServe:
+			conf.serveSocket = optarg;
+			break;
+		case optFanout:
+			conf.fanoutTargets = optarg;
+			break;
+		case optFormat:
+			if (parseFormat(optarg, &conf.format) != 0) {
+				printf("error: invalid format: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			break;
+		case optPalette:
+			if (cbonsaiPaletteParse(&conf.palette, optarg) != 0) {
+				printf("error: invalid palette: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			break;
+		case optLeafFile:
+			conf.leafFile = optarg;
+			break;
+		case optThreads:
+			if (strtold(optarg, NULL) != 0) conf.threads = strtod(optarg, NULL);
+			else {
+				printf("error: invalid number of threads: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			if (conf.threads < 1 || conf.threads > 256) {
+				printf("error: invalid number of threads: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			break;
+		case optExportScene:
+			conf.exportFile = optarg;
+			break;
+		case optLoadScene:
+			conf.sceneFile = optarg;
+			break;
+		case optKeepGrowing:
+			conf.growthFile = optarg;
+			break;
+		case optGrowLife:
+		case optGrowSteps:
+			if (strtold(optarg, NULL) != 0 && strtod(optarg, NULL) >= 1) {
+				if (c == optGrowLife) conf.growLife = strtod(optarg, NULL);
+				else conf.growSteps = strtod(optarg, NULL);
+			}
+			else {
+				printf("error: invalid amount of growth: '%s'\n", optarg);
+				quit(&conf, &objects, &scene, 1);
+			}
+			break;
 		case 'v':
 			conf.verbosity++;
 			break;
@@ -986,51 +3484,76 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
-	// delimit leaves on "," and add each token to the leaves[] list
-	char *token = strtok(leavesInput, ",");
-	while (token != NULL) {
-		if (conf.leavesSize < 100) conf.leaves[conf.leavesSize] = token;
-		token = strtok(NULL, ",");
-		conf.leavesSize++;
+	// the ring file of --pregen is the only argument that is not an option
+	if (conf.pregenCount) {
+		if (optind != argc - 1) {
+			printf("error: option requires a file -- 'pregen'\n");
+			quit(&conf, &objects, &scene, 1);
+		}
+		conf.pregenFile = argv[optind];
 	}
 
+	if (loadLeaves(&conf) != 0)
+		quit(&conf, &objects, &scene, 1);
+
 	if (conf.load)
 		loadFromFile(&conf);
 
-	// seed random number generator
+	// seed random number generators
 	if (conf.seed == 0) conf.seed = time(NULL);
 	srand(conf.seed);
 
-	struct counters myCounters;
+	// modes that never open the terminal
+	if (conf.nextFile)
+		quit(&conf, &objects, &scene, printNext(conf.nextFile));
+	if (conf.pregenCount)
+		quit(&conf, &objects, &scene, pregenerate(&conf));
+	if (conf.serveSocket)
+		quit(&conf, &objects, &scene, serve(&conf));
+	if (conf.fanoutTargets) {
+		fitTerminalPalette(&conf);
+		quit(&conf, &objects, &scene, fanout(&conf));
+	}
+	if (conf.exportFile)
+		quit(&conf, &objects, &scene, exportScene(&conf));
+	if (conf.sceneFile)
+		quit(&conf, &objects, &scene, printSceneFile(&conf));
+	if (conf.growthFile) {
+		if (!conf.growLife && !conf.growSteps) conf.growLife = 4;
+		quit(&conf, &objects, &scene, keepGrowing(&conf));
+	}
+	if (conf.printTree && !conf.live && !conf.infinite)
+		quit(&conf, &objects, &scene, printCanvas(&conf));
+
+	struct counters myCounters = {0};
+	clock_gettime(CLOCK_MONOTONIC, &myCounters.runStart);
 
+	// set up the screen once; later trees reuse its windows, so that in
+	// infinite mode each tree only reuses memory taken by earlier ones
+	fitTerminalPalette(&conf);
+	init(&conf, &objects);
 	do {
-		init(&conf, &objects);
-		growTree(&conf, &objects, &myCounters);
+		growNext(&conf, &objects, &scene, &myCounters);
 		if (conf.load) conf.targetBranchCount = 0;
 		if (conf.infinite) {
-			timeout(conf.timeWait * 1000);
-			if (checkKeyPress(&conf, &myCounters) == 1)
-				quit(&conf, &objects, 0);
+			if (checkKeyPress(&conf, &objects, &scene, &myCounters, conf.timeWait) == 1)
+				quit(&conf, &objects, &scene, 0);
 
-			// seed random number generator
-			srand(time(NULL));
+			// seed the next tree, and clear the last one away
+			conf.seed = time(NULL);
+			werase(objects.treeWin);
 		}
 	} while (conf.infinite);
 
 	if (conf.printTree) {
+		int rows, cols;
+		getmaxyx(stdscr, rows, cols);
 		finish(&conf, &myCounters);
-
-		// overlay all windows onto stdscr
-		overlay(objects.baseWin, stdscr);
-		overlay(objects.treeWin, stdscr);
-		overwrite(objects.messageBorderWin, stdscr);
-		overwrite(objects.messageWin, stdscr);
-
-		printstdscr();
+		printScene(&conf, &scene, &myCounters.tree, rows, cols);
 	} else {
-		wgetch(objects.treeWin);
+		waitForKey(&conf, &objects, &scene, &myCounters, -1);
 		finish(&conf, &myCounters);
 	}
 
-	quit(&conf, &objects, 0);
+	quit(&conf, &objects, &scene, 0);
 }
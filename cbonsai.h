@@ -0,0 +1,362 @@
+#ifndef CBONSAI_H
+#define CBONSAI_H
+
+/*
+ * libcbonsai: the cbonsai growth engine, without curses.
+ *
+ * Trees are grown into a caller-provided canvas of cells. Anything the engine
+ * needs to keep (e.g. the scene of a tree) is taken from an arena, whose
+ * memory is supplied by the caller and can be reset between trees, so growing
+ * a tree does not have to touch the heap at all.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// cbonsaiNoBranch marks what is painted around the tree, like its base
+enum cbonsaiBranchType {cbonsaiTrunk, cbonsaiShootLeft, cbonsaiShootRight, cbonsaiDying, cbonsaiDead, cbonsaiNoBranch};
+enum cbonsaiBudget {cbonsaiBudgetOk, cbonsaiBudgetLow, cbonsaiBudgetSpent};
+
+/* palette */
+
+// what a painted cell is, for choosing its color
+enum cbonsaiRole {cbonsaiRoleWood, cbonsaiRoleDying, cbonsaiRoleDead, cbonsaiRolePot, cbonsaiRoleMoss, cbonsaiRoleStump, cbonsaiRoleText, cbonsaiRoles};
+enum cbonsaiGradient {cbonsaiGradientNone, cbonsaiGradientDepth, cbonsaiGradientAge};
+
+// steps of a gradient
+#define CBONSAI_LEVELS 8
+
+// the index of an attribute in a palette: each role has a plain and a
+// highlighted (bold) variant, at each level of the gradient
+#define CBONSAI_ATTR(role, variant, level) ((((role) * 2) + (variant)) * CBONSAI_LEVELS + (level))
+#define CBONSAI_ATTRS (cbonsaiRoles * 2 * CBONSAI_LEVELS)
+
+struct cbonsaiAttr {
+	int rgb;		// 0xrrggbb, or -1 to leave the color to the terminal
+	unsigned char color;	// the closest of the 16 terminal colors, 0 for the default color
+	unsigned char color256;	// the closest of the 256 xterm colors
+	unsigned char bold;
+};
+
+// every attribute a tree can be painted with, resolved once so that painting
+// a step only looks one up
+struct cbonsaiPalette {
+	enum cbonsaiGradient gradient;
+	int colors;		// colors of the output: 16, 256, or 16777216 for 24-bit colors
+	struct cbonsaiAttr attrs[CBONSAI_ATTRS];
+};
+
+// fill a palette from a description like "sakura,wood=#5c4033:#a0785a,
+// gradient=age": a named palette (classic, autumn, sakura or mono), and the
+// colors of roles. a role takes a color or a gradient from:to, and optionally
+// /another for its highlighted variant; colors are #rrggbb or 0-15. anything
+// left out is classic, and the palette takes 24-bit colors. returns -1 if the
+// description is invalid
+int cbonsaiPaletteParse(struct cbonsaiPalette* palette, const char* spec);
+
+// leaves with weights, prepared so that choosing one takes constant time
+// however many there are (Vose's alias method)
+struct cbonsaiLeafSet {
+	const char* const* leaves;
+	int count;
+	unsigned char* widths;	// columns taken by the first glyph of each leaf
+	uint32_t* cutoffs;	// a chosen column is kept below its cutoff,
+	int* aliases;		// and replaced by its alias otherwise
+};
+
+struct cbonsaiConfig {
+	int lifeStart;		// life; higher -> more growth
+	int multiplier;		// branch multiplier; higher -> more branching
+	unsigned long seed;
+
+	// strings randomly chosen for leaves; must outlive any scene or canvas
+	const char* const* leaves;
+	int leavesSize;
+
+	// weighted leaves, used instead of leaves when set
+	const struct cbonsaiLeafSet* leafSet;
+
+	// growth budgets, 0 for none. the last tenth of maxSteps and timeLimit
+	// is left to trunks still growing; no step is taken past either
+	int maxSteps;
+	int maxBranches;
+	double timeLimit;	// in seconds of wall-clock time
+
+	// colors; NULL for the classic palette
+	const struct cbonsaiPalette* palette;
+
+	// 0 to draw every random number of a tree from one stream. otherwise
+	// each branch draws from its own stream, derived from its parent's, and
+	// cbonsaiGrow() grows branches on this many threads when there are no
+	// budgets. the tree then depends on the seed but not on the number of
+	// threads, though it differs from the tree grown with 0
+	int threads;
+};
+
+struct cbonsaiStats {
+	int branches;
+	int shoots;
+	int steps;
+	int pruned;
+	enum cbonsaiBudget budget;
+};
+
+// a single painted step of a tree
+struct cbonsaiPaint {
+	int y;			// relative to the base of the trunk; up is negative
+	int x;
+	const char* str;	// static, or one of the configured leaves
+	unsigned char attr;	// index into the palette, see CBONSAI_ATTR()
+	unsigned char type;	// enum cbonsaiBranchType
+	unsigned char width;	// columns taken by the first glyph of str, 0 if not known
+};
+
+/* arena */
+
+struct cbonsaiArenaBlock {
+	struct cbonsaiArenaBlock* next;
+	size_t size;		// usable bytes following the header
+	size_t used;
+	int grown;		// whether it was obtained through arena->grow
+};
+
+struct cbonsaiArena {
+	struct cbonsaiArenaBlock* first;
+	struct cbonsaiArenaBlock* current;
+
+	// optional, set after cbonsaiArenaInit(): called for another block when
+	// all blocks are full. without it, the arena never grows past the buffer
+	// given to cbonsaiArenaInit()
+	void* (*grow)(size_t size);
+};
+
+// set up an arena on the given buffer, which may be NULL for an arena that
+// only grows through arena->grow
+void cbonsaiArenaInit(struct cbonsaiArena* arena, void* buffer, size_t size);
+
+// returns NULL if the arena is full and cannot grow
+void* cbonsaiArenaAlloc(struct cbonsaiArena* arena, size_t size);
+
+// forget all allocations, but keep every block for reuse
+void cbonsaiArenaReset(struct cbonsaiArena* arena);
+
+// hand the blocks obtained through arena->grow to release, e.g. free()
+void cbonsaiArenaRelease(struct cbonsaiArena* arena, void (*release)(void*));
+
+/* scene */
+
+struct cbonsaiSceneChunk {
+	struct cbonsaiSceneChunk* next;
+	int count;
+	struct cbonsaiPaint paints[256];
+};
+
+// every step painted while growing a tree, in order, kept in an arena
+struct cbonsaiScene {
+	struct cbonsaiArena* arena;
+	struct cbonsaiSceneChunk* first;
+	struct cbonsaiSceneChunk* last;
+	size_t count;
+};
+
+void cbonsaiSceneInit(struct cbonsaiScene* scene, struct cbonsaiArena* arena);
+
+// returns -1 if the arena is full
+int cbonsaiSceneAdd(struct cbonsaiScene* scene, const struct cbonsaiPaint* paint);
+
+/* canvas */
+
+// a cell of a canvas
+struct cbonsaiCell {
+	char glyph[8];		// UTF-8, empty if nothing was painted here
+	unsigned char width;	// columns taken by the glyph, 0 for the right half of a wide glyph
+	unsigned char attr;
+	unsigned char type;
+};
+
+struct cbonsaiCanvas {
+	struct cbonsaiCell* cells;	// rows * cols cells, row by row
+	int rows;
+	int cols;
+
+	// where the base of the trunk goes; cbonsaiCanvasInit() picks the bottom center
+	int anchorY;
+	int anchorX;
+
+	// colors for writing the canvas out; NULL for the classic palette
+	const struct cbonsaiPalette* palette;
+};
+
+void cbonsaiCanvasInit(struct cbonsaiCanvas* canvas, struct cbonsaiCell* cells, int rows, int cols);
+void cbonsaiCanvasClear(struct cbonsaiCanvas* canvas);
+
+// paint a step onto the canvas the way curses would paint it in a window:
+// nothing from outside it, and text past its right edge on the next row, up
+// to its last cell. steps of the tree are painted in a window that ends at
+// the anchor row, everything else in the whole canvas. like curses, wide
+// glyphs are only painted on even columns so they never overlap
+void cbonsaiCanvasPaint(struct cbonsaiCanvas* canvas, const struct cbonsaiPaint* paint);
+
+// paint every step of a scene onto the canvas
+void cbonsaiCanvasPaintScene(struct cbonsaiCanvas* canvas, const struct cbonsaiScene* scene);
+
+// write the canvas as text with ANSI colors, one line per row, leaving out
+// blank rows above the tree and trailing blanks. returns -1 on write errors
+int cbonsaiCanvasWriteAnsi(const struct cbonsaiCanvas* canvas, FILE* fp);
+
+// the same, but keeping the blank rows above the tree, so that every row of
+// the screen the canvas stands for is written
+int cbonsaiCanvasWriteAnsiScreen(const struct cbonsaiCanvas* canvas, FILE* fp);
+
+// write cols cells of a row, after moving the cursor there, to update a
+// terminal that shows the whole canvas. returns -1 on write errors
+int cbonsaiCanvasWriteAnsiSpan(const struct cbonsaiCanvas* canvas, int y, int x, int cols, FILE* fp);
+
+// write the canvas as a <pre> element, or as an SVG image, in one pass and
+// with one element for each run of cells with the same colors. like the
+// ANSI writer, these leave out blank rows above and below the tree
+int cbonsaiCanvasWriteHtml(const struct cbonsaiCanvas* canvas, FILE* fp);
+int cbonsaiCanvasWriteSvg(const struct cbonsaiCanvas* canvas, FILE* fp);
+
+/* base */
+
+// a piece of the ascii-art plant base
+struct cbonsaiBaseSegment {
+	int y;
+	int x;
+	unsigned char attr;
+	const char* str;
+};
+
+// the segments of a base, ending with one without str, and the base size.
+// returns NULL for base 0 (no base) or an unknown base
+const struct cbonsaiBaseSegment* cbonsaiBase(int baseType, int* rows, int* cols);
+
+// paint a base right below the anchor of the canvas; the anchor has to be
+// moved up to make room for it
+void cbonsaiCanvasPaintBase(struct cbonsaiCanvas* canvas, int baseType);
+
+/* leaves */
+
+// columns taken by the first glyph of a string in the current locale, or -1
+// if it does not start with a printable character
+int cbonsaiGlyphWidth(const char* str);
+
+// prepare a leaf set, taking its tables from an arena. weights may be NULL
+// for equal weights. returns -1 if a leaf is not printable, a weight is
+// negative, all weights are 0, or the arena is full
+int cbonsaiLeafSetInit(struct cbonsaiLeafSet* set, const char* const* leaves, const double* weights, int count, struct cbonsaiArena* arena);
+
+/* growth */
+
+// a branch as it starts growing
+struct cbonsaiBranch {
+	int id;			// branches are numbered from 0 in the order they start
+	int parent;		// the branch it grew out of, -1 for the first trunk
+	int y;			// where it starts, relative to the base of the trunk
+	int x;
+	int life;
+	int depth;
+	unsigned char type;	// enum cbonsaiBranchType
+};
+
+// a growing tree. set conf and any hooks, then call cbonsaiGrowTree()
+struct cbonsaiTree {
+	const struct cbonsaiConfig* conf;
+
+	// optional hooks. onStep is called before each step of growth, and
+	// growth stops once it returns nonzero. onBranch is called as each
+	// branch starts, and onPaint with each painted step
+	int (*onStep)(struct cbonsaiTree* tree);
+	void (*onBranch)(struct cbonsaiTree* tree, const struct cbonsaiBranch* branch);
+	void (*onPaint)(struct cbonsaiTree* tree, const struct cbonsaiPaint* paint);
+	void* userData;
+
+	struct cbonsaiStats stats;
+
+	// the branch being grown, for hooks
+	int branch;
+
+	// the most recent step, for debugging output
+	int dx;
+	int dy;
+	int shootCooldown;
+
+	// private
+	uint64_t rng;			// the stream of a branch, see threads
+	int32_t classic[31];		// the stream of the whole tree otherwise
+	int classicFront;
+	int classicRear;
+	unsigned shootCounter;
+	int stopped;
+	struct timespec startTime;
+	struct cbonsaiWorker* worker;	// when growing on several threads
+	struct cbonsaiTips* tips;	// when growing in installments
+	struct cbonsaiTip* tip;
+};
+
+void cbonsaiGrowTree(struct cbonsaiTree* tree);
+
+// grow a tree onto a cleared canvas and record it in a scene. any of canvas,
+// scene and stats may be NULL. growing on several threads (see threads in
+// struct cbonsaiConfig) takes memory from malloc(). returns -1 if the
+// scene's arena or the heap ran out
+int cbonsaiGrow(const struct cbonsaiConfig* conf, struct cbonsaiCanvas* canvas, struct cbonsaiScene* scene, struct cbonsaiStats* stats);
+
+/* growth in installments */
+
+// a branch that is still growing, with all it needs to go on where it stopped
+struct cbonsaiTip {
+	int id;
+	int y;
+	int x;
+	int life;
+	int depth;
+	int dx;
+	int dy;
+	int shootCooldown;
+	unsigned spawned;	// branches it has spawned so far
+	uint64_t rng;		// its own stream of random numbers
+	unsigned shootCounter;
+	unsigned char type;	// enum cbonsaiBranchType
+
+	// private
+	int window;		// steps it may still take in this installment
+	struct cbonsaiTip* next;
+};
+
+// the tips of a tree that grows a little at a time, e.g. a few steps a day,
+// in the order they grow, kept in an arena. finished tips are reused
+struct cbonsaiTips {
+	struct cbonsaiArena* arena;
+	struct cbonsaiTip* first;
+	struct cbonsaiTip* last;
+	struct cbonsaiTip* unused;
+	size_t count;
+	int full;
+};
+
+void cbonsaiTipsInit(struct cbonsaiTips* tips, struct cbonsaiArena* arena);
+
+// add a tip, e.g. one saved by an earlier installment. returns -1 if the
+// arena is full
+int cbonsaiTipsAdd(struct cbonsaiTips* tips, const struct cbonsaiTip* tip);
+
+// add the trunk of a new tree, counting it in tree->stats and passing it to
+// tree->onBranch. returns -1 if the arena is full
+int cbonsaiTipsPlant(struct cbonsaiTree* tree, struct cbonsaiTips* tips);
+
+// grow the next installment of a tree: each tip takes up to life steps, and
+// each branch spawned along the way takes what is left of those, until steps
+// steps were taken in all; 0 for no limit. new branches are added to the
+// tips, and finished ones removed. like with threads in struct cbonsaiConfig,
+// every branch draws from its own stream, so a tree grown in any number of
+// installments has the same branches, though later steps may paint over
+// different ones. set tree->stats to carry on counting, and tree->conf and
+// hooks as for cbonsaiGrowTree(). growth budgets are not used. returns -1 if
+// the arena ran out
+int cbonsaiGrowTips(struct cbonsaiTree* tree, struct cbonsaiTips* tips, int life, int steps);
+
+#endif
@@ -22,6 +22,8 @@ _cbonsai()
     '--base'
     '-c'
     '--leaf'
+    '--leaf-file'
+    '--threads'
     '-M'
     '--multiplier'
     '-L'
@@ -34,6 +36,23 @@ _cbonsai()
     '--save'
     '-C'
     '--load'
+    '--max-steps'
+    '--max-branches'
+    '--time-limit'
+    '--ambient'
+    '--max-wakeups'
+    '--geometry'
+    '--pregen'
+    '--next'
+    '--serve'
+    '--fanout'
+    '--format'
+    '--palette'
+    '--export-scene'
+    '--load-scene'
+    '--keep-growing'
+    '--grow-life'
+    '--grow-steps'
     '-v'
     '--verbose'
     '-h'
@@ -41,11 +60,19 @@ _cbonsai()
   )
 
   case "$prev" in
-    -[WC]|--save|--load)
+    --format)
+      COMPREPLY=($(compgen -W "ansi html svg" -- "$cur"))
+      return
+      ;;
+    --palette)
+      COMPREPLY=($(compgen -W "classic autumn sakura mono" -- "$cur"))
+      return
+      ;;
+    -[WC]|--save|--load|--next|--serve|--fanout|--leaf-file|--export-scene|--load-scene|--keep-growing)
       COMPREPLY=($(compgen -f -- "$cur"))
       return
       ;;
-    -[twmbcMLs]|--time|--wait|--message|--base|--leaf|--multiplier|--life|--seed)
+    -[twmbcMLs]|--time|--wait|--message|--base|--leaf|--multiplier|--life|--seed|--max-steps|--max-branches|--time-limit|--max-wakeups|--geometry|--pregen|--threads|--grow-life|--grow-steps)
       return
       ;;
   esac
@@ -0,0 +1,1717 @@
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 500
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <limits.h>
+#include <time.h>
+
+#include "cbonsai.h"
+
+/* arena */
+
+// allocations (and block headers) are aligned for any type we store
+#define ARENA_ALIGN 16
+
+static size_t alignUp(size_t size) {
+	return (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+}
+
+static void* blockData(struct cbonsaiArenaBlock* block) {
+	return (char*) block + alignUp(sizeof(*block));
+}
+
+void cbonsaiArenaInit(struct cbonsaiArena* arena, void* buffer, size_t size) {
+	arena->first = NULL;
+	arena->current = NULL;
+	arena->grow = NULL;
+
+	if (!buffer) return;
+
+	// the caller's buffer becomes the first block, if a header fits in it
+	size_t skip = alignUp((uintptr_t) buffer) - (uintptr_t) buffer;
+	if (size < skip + alignUp(sizeof(struct cbonsaiArenaBlock))) return;
+
+	struct cbonsaiArenaBlock* block = (struct cbonsaiArenaBlock*) ((char*) buffer + skip);
+	block->next = NULL;
+	block->size = size - skip - alignUp(sizeof(*block));
+	block->used = 0;
+	block->grown = 0;
+
+	arena->first = block;
+	arena->current = block;
+}
+
+void* cbonsaiArenaAlloc(struct cbonsaiArena* arena, size_t size) {
+	size = alignUp(size);
+
+	// blocks past the current one are empty, so take the first one that fits
+	struct cbonsaiArenaBlock* block = arena->current;
+	while (block && block->size - block->used < size)
+		block = block->next;
+
+	if (!block) {
+		if (!arena->grow) return NULL;
+
+		size_t blockSize = size > 65536 ? size : 65536;
+		block = arena->grow(alignUp(sizeof(*block)) + blockSize);
+		if (!block) return NULL;
+		block->next = NULL;
+		block->size = blockSize;
+		block->used = 0;
+		block->grown = 1;
+
+		// append the new block to the chain
+		struct cbonsaiArenaBlock** last = &arena->first;
+		while (*last) last = &(*last)->next;
+		*last = block;
+	}
+
+	void* ptr = (char*) blockData(block) + block->used;
+	block->used += size;
+	arena->current = block;
+	return ptr;
+}
+
+void cbonsaiArenaReset(struct cbonsaiArena* arena) {
+	for (struct cbonsaiArenaBlock* block = arena->first; block; block = block->next)
+		block->used = 0;
+	arena->current = arena->first;
+}
+
+void cbonsaiArenaRelease(struct cbonsaiArena* arena, void (*release)(void*)) {
+	struct cbonsaiArenaBlock** link = &arena->first;
+	while (*link) {
+		struct cbonsaiArenaBlock* block = *link;
+		if (block->grown) {
+			*link = block->next;
+			release(block);
+		} else {
+			block->used = 0;
+			link = &block->next;
+		}
+	}
+	arena->current = arena->first;
+}
+
+/* scene */
+
+void cbonsaiSceneInit(struct cbonsaiScene* scene, struct cbonsaiArena* arena) {
+	scene->arena = arena;
+	scene->first = NULL;
+	scene->last = NULL;
+	scene->count = 0;
+}
+
+int cbonsaiSceneAdd(struct cbonsaiScene* scene, const struct cbonsaiPaint* paint) {
+	struct cbonsaiSceneChunk* chunk = scene->last;
+
+	// start a new chunk when the last one is full
+	if (!chunk || chunk->count == (int) (sizeof(chunk->paints) / sizeof(chunk->paints[0]))) {
+		chunk = cbonsaiArenaAlloc(scene->arena, sizeof(*chunk));
+		if (!chunk) return -1;
+		chunk->next = NULL;
+		chunk->count = 0;
+
+		if (scene->last) scene->last->next = chunk;
+		else scene->first = chunk;
+		scene->last = chunk;
+	}
+
+	chunk->paints[chunk->count++] = *paint;
+	scene->count++;
+	return 0;
+}
+
+/* palette */
+
+// the colors of xterm, for resolving colors and for formats that need them
+// spelled out
+static const int xtermColors[16] = {
+	0x000000, 0xcd0000, 0x00cd00, 0xcdcd00, 0x0000ee, 0xcd00cd, 0x00cdcd, 0xe5e5e5,
+	0x7f7f7f, 0xff0000, 0x00ff00, 0xffff00, 0x5c5cff, 0xff00ff, 0x00ffff, 0xffffff,
+};
+
+static const char* const roleNames[cbonsaiRoles] = {
+	"wood", "dying", "dead", "pot", "moss", "stump", "text",
+};
+
+// the named palettes. classic is the original colors of cbonsai, and the
+// starting point of every other palette
+static const struct {
+	const char* name;
+	const char* spec;
+} namedPalettes[] = {
+	{ "classic", "wood=3/11,dying=2,dead=10,pot=8,moss=2,stump=11,text=0" },
+	{ "autumn", "wood=#4a2f1b:#8b5a2b,dying=#b8860b:#ff8c00,dead=#8b1a1a:#ff4500,"
+			"pot=#8b7d6b,moss=#6b8e23,stump=#a0522d,gradient=age" },
+	{ "sakura", "wood=#3e2a1f:#7a5c45,dying=#ff9eb5:#ffe4ec,dead=#d1477a:#ffb7c5,"
+			"pot=#9e9e9e,moss=#6b8e23,stump=#7a5c45,gradient=depth" },
+	{ "mono", "wood=#6c6c6c:#bcbcbc,dying=#8a8a8a:#eeeeee,dead=#585858:#d0d0d0,"
+			"pot=#808080,moss=#a8a8a8,stump=#bcbcbc,gradient=depth" },
+};
+
+// a color of a palette description: 24-bit, or one of the 16 terminal colors
+struct colorSpec {
+	int rgb;	// -1 for a terminal color
+	int color;
+};
+
+// the colors of a role: a gradient from one color to another, for each variant
+struct roleSpec {
+	struct colorSpec from[2];
+	struct colorSpec to[2];
+};
+
+static int colorDistance(int a, int b) {
+	int dr = ((a >> 16) & 0xff) - ((b >> 16) & 0xff);
+	int dg = ((a >> 8) & 0xff) - ((b >> 8) & 0xff);
+	int db = (a & 0xff) - (b & 0xff);
+	return dr * dr + dg * dg + db * db;
+}
+
+// the closest terminal color, leaving out black, which is often the background
+static int nearestColor(int rgb) {
+	int best = 1;
+	for (int i = 2; i < 16; i++) {
+		if (colorDistance(rgb, xtermColors[i]) < colorDistance(rgb, xtermColors[best]))
+			best = i;
+	}
+	return best;
+}
+
+// the closest color of the xterm 6x6x6 cube and gray ramp
+static int nearestColor256(int rgb) {
+	static const int levels[6] = { 0x00, 0x5f, 0x87, 0xaf, 0xd7, 0xff };
+	int cube = 16, cubeRgb = 0;
+	for (int shift = 16; shift >= 0; shift -= 8) {
+		int value = (rgb >> shift) & 0xff, level = 0;
+		for (int i = 1; i < 6; i++) {
+			if (abs(levels[i] - value) < abs(levels[level] - value)) level = i;
+		}
+		cube += level * (shift == 16 ? 36 : shift == 8 ? 6 : 1);
+		cubeRgb |= levels[level] << shift;
+	}
+
+	int gray = (((rgb >> 16) & 0xff) + ((rgb >> 8) & 0xff) + (rgb & 0xff)) / 3;
+	int step = gray < 8 ? 0 : gray > 238 ? 23 : (gray - 8 + 5) / 10;
+	int grayValue = 8 + step * 10;
+	int grayRgb = (grayValue << 16) | (grayValue << 8) | grayValue;
+
+	return colorDistance(rgb, grayRgb) < colorDistance(rgb, cubeRgb) ? 232 + step : cube;
+}
+
+// mix two colors, weight out of 255 towards b
+static int mixColors(int a, int b, int weight) {
+	int mixed = 0;
+	for (int shift = 16; shift >= 0; shift -= 8) {
+		int from = (a >> shift) & 0xff, to = (b >> shift) & 0xff;
+		mixed |= ((from * (255 - weight) + to * weight + 127) / 255) << shift;
+	}
+	return mixed;
+}
+
+static int parseColor(const char* str, size_t len, struct colorSpec* color) {
+	char buf[16];
+	if (len == 0 || len >= sizeof(buf)) return -1;
+	memcpy(buf, str, len);
+	buf[len] = '\0';
+
+	char* end;
+	if (buf[0] == '#') {
+		if (len != 7 || strspn(buf + 1, "0123456789abcdefABCDEF") != 6) return -1;
+		color->rgb = (int) strtol(buf + 1, &end, 16);
+		color->color = 0;
+	}
+	else {
+		color->rgb = -1;
+		color->color = (int) strtol(buf, &end, 10);
+		if (color->color < 0 || color->color > 15) return -1;
+	}
+	return *end == '\0' ? 0 : -1;
+}
+
+// parse "from[:to]" of a variant
+static int parseGradient(const char* str, size_t len, struct colorSpec* from, struct colorSpec* to) {
+	const char* colon = memchr(str, ':', len);
+	if (!colon) {
+		if (parseColor(str, len, from) != 0) return -1;
+		*to = *from;
+		return 0;
+	}
+	if (parseColor(str, colon - str, from) != 0) return -1;
+	return parseColor(colon + 1, len - (colon + 1 - str), to);
+}
+
+static int parseRole(const char* str, size_t len, struct roleSpec* role) {
+	const char* slash = memchr(str, '/', len);
+	if (!slash) {
+		if (parseGradient(str, len, &role->from[0], &role->to[0]) != 0) return -1;
+
+		// the highlighted variant is the same color, a little lighter
+		for (int i = 0; i < 2; i++) {
+			struct colorSpec* color = i ? &role->to[1] : &role->from[1];
+			*color = i ? role->to[0] : role->from[0];
+			if (color->rgb >= 0) color->rgb = mixColors(color->rgb, 0xffffff, 64);
+		}
+		return 0;
+	}
+	if (parseGradient(str, slash - str, &role->from[0], &role->to[0]) != 0) return -1;
+	return parseGradient(slash + 1, len - (slash + 1 - str), &role->from[1], &role->to[1]);
+}
+
+static int parseSpec(const char* spec, struct roleSpec* roles, enum cbonsaiGradient* gradient) {
+	while (*spec) {
+		size_t len = strcspn(spec, ",");
+		const char* equals = memchr(spec, '=', len);
+
+		// a named palette, which the rest of the description can change
+		if (!equals) {
+			size_t i = 0;
+			while (i < sizeof(namedPalettes) / sizeof(namedPalettes[0])
+					&& (strlen(namedPalettes[i].name) != len || strncmp(spec, namedPalettes[i].name, len)))
+				i++;
+			if (i == sizeof(namedPalettes) / sizeof(namedPalettes[0])
+					|| parseSpec(namedPalettes[i].spec, roles, gradient) != 0)
+				return -1;
+
+			spec += len;
+			if (*spec == ',') spec++;
+			continue;
+		}
+
+		size_t keyLen = equals - spec;
+		const char* value = equals + 1;
+		size_t valueLen = len - keyLen - 1;
+
+		if (keyLen == 8 && !strncmp(spec, "gradient", 8)) {
+			if (valueLen == 4 && !strncmp(value, "none", 4)) *gradient = cbonsaiGradientNone;
+			else if (valueLen == 5 && !strncmp(value, "depth", 5)) *gradient = cbonsaiGradientDepth;
+			else if (valueLen == 3 && !strncmp(value, "age", 3)) *gradient = cbonsaiGradientAge;
+			else return -1;
+		}
+		else {
+			int role = 0;
+			while (role < cbonsaiRoles && (strlen(roleNames[role]) != keyLen || strncmp(spec, roleNames[role], keyLen)))
+				role++;
+			if (role == cbonsaiRoles || parseRole(value, valueLen, &roles[role]) != 0) return -1;
+		}
+
+		spec += len;
+		if (*spec == ',') spec++;
+	}
+	return 0;
+}
+
+// the color of a role at a level of its gradient
+static void resolveAttr(const struct colorSpec* from, const struct colorSpec* to, int level, struct cbonsaiAttr* attr) {
+	if (from->rgb < 0 && to->rgb < 0) {
+		attr->rgb = -1;
+		attr->color = level < CBONSAI_LEVELS / 2 ? from->color : to->color;
+		attr->color256 = attr->color;
+		return;
+	}
+
+	int a = from->rgb >= 0 ? from->rgb : xtermColors[from->color];
+	int b = to->rgb >= 0 ? to->rgb : xtermColors[to->color];
+	attr->rgb = mixColors(a, b, level * 255 / (CBONSAI_LEVELS - 1));
+	attr->color = nearestColor(attr->rgb);
+	attr->color256 = nearestColor256(attr->rgb);
+}
+
+int cbonsaiPaletteParse(struct cbonsaiPalette* palette, const char* spec) {
+	struct roleSpec roles[cbonsaiRoles];
+	enum cbonsaiGradient gradient = cbonsaiGradientNone;
+
+	if (parseSpec(namedPalettes[0].spec, roles, &gradient) != 0 || parseSpec(spec, roles, &gradient) != 0)
+		return -1;
+
+	palette->gradient = gradient;
+	palette->colors = 1 << 24;
+	for (int role = 0; role < cbonsaiRoles; role++) {
+		for (int variant = 0; variant < 2; variant++) {
+			for (int level = 0; level < CBONSAI_LEVELS; level++) {
+				struct cbonsaiAttr* attr = &palette->attrs[CBONSAI_ATTR(role, variant, level)];
+				resolveAttr(&roles[role].from[variant], &roles[role].to[variant], level, attr);
+				attr->bold = variant;
+			}
+		}
+	}
+	return 0;
+}
+
+// the classic palette, for canvases without one; parsed once, by whichever
+// thread writes such a canvas first
+static struct cbonsaiPalette classicPalette;
+static pthread_once_t classicOnce = PTHREAD_ONCE_INIT;
+
+static void parseClassic(void) {
+	cbonsaiPaletteParse(&classicPalette, "classic");
+}
+
+// the palette of a canvas
+static const struct cbonsaiPalette* canvasPalette(const struct cbonsaiCanvas* canvas) {
+	if (canvas->palette) return canvas->palette;
+	pthread_once(&classicOnce, parseClassic);
+	return &classicPalette;
+}
+
+/* canvas */
+
+void cbonsaiCanvasInit(struct cbonsaiCanvas* canvas, struct cbonsaiCell* cells, int rows, int cols) {
+	canvas->cells = cells;
+	canvas->rows = rows;
+	canvas->cols = cols;
+	canvas->anchorY = rows - 1;
+	canvas->anchorX = cols / 2;
+	canvas->palette = NULL;
+}
+
+void cbonsaiCanvasClear(struct cbonsaiCanvas* canvas) {
+	memset(canvas->cells, 0, (size_t) canvas->rows * canvas->cols * sizeof(*canvas->cells));
+}
+
+// blank a cell, along with the other half of a wide glyph it is part of
+static void clearCell(struct cbonsaiCanvas* canvas, int y, int x) {
+	struct cbonsaiCell* row = &canvas->cells[(size_t) y * canvas->cols];
+
+	if (row[x].width == 0 && row[x].glyph[0] == '\0' && x > 0 && row[x - 1].width == 2)
+		memset(&row[x - 1], 0, sizeof(row[x - 1]));
+	else if (row[x].width == 2 && x + 1 < canvas->cols)
+		memset(&row[x + 1], 0, sizeof(row[x + 1]));
+
+	memset(&row[x], 0, sizeof(row[x]));
+}
+
+void cbonsaiCanvasPaint(struct cbonsaiCanvas* canvas, const struct cbonsaiPaint* paint) {
+	int y = canvas->anchorY + paint->y;
+	int x = canvas->anchorX + paint->x;
+
+	// the tree is painted in a window that ends at the row of its anchor,
+	// like the tree window of curses, and the rest in the whole canvas
+	int rows = canvas->rows;
+	if (paint->type < cbonsaiNoBranch && canvas->anchorY + 1 < rows)
+		rows = canvas->anchorY + 1;
+
+	// like mvwprintw(), nothing is painted from outside the window
+	if (y < 0 || y >= rows || x < 0 || x >= canvas->cols) return;
+
+	const char* str = paint->str;
+	mbstate_t state;
+	memset(&state, 0, sizeof(state));
+
+	// ensure wide characters don't overlap
+	wchar_t wc = 0;
+	int firstWidth = paint->width;
+	if (!firstWidth) {
+		mbrtowc(&wc, str, MB_LEN_MAX, &state);
+		firstWidth = wcwidth(wc);
+	}
+	if (firstWidth > 1 && x % firstWidth != 0) return;
+
+	struct cbonsaiCell* row = &canvas->cells[(size_t) y * canvas->cols];
+	struct cbonsaiCell* last = NULL;
+	memset(&state, 0, sizeof(state));
+	while (*str) {
+		// ASCII needs no decoding, and takes a column
+		size_t len = 1;
+		int width = 1;
+		if ((unsigned char) *str >= 0x80) {
+			len = mbrtowc(&wc, str, MB_LEN_MAX, &state);
+			if (len == (size_t) -1 || len == (size_t) -2) break;
+			width = wcwidth(wc);
+		}
+
+		// zero-width characters combine with the previous glyph
+		if (width == 0) {
+			if (last && strlen(last->glyph) + len < sizeof(last->glyph))
+				strncat(last->glyph, str, len);
+			str += len;
+			continue;
+		}
+		if (width < 0) width = 1;
+		if (width > canvas->cols) break;
+
+		// a wide glyph that does not fit blanks the rest of the row, and
+		// goes to the next one
+		if (x + width > canvas->cols) {
+			while (x < canvas->cols)
+				clearCell(canvas, y, x++);
+			if (++y >= rows) break;
+			x = 0;
+			row = &canvas->cells[(size_t) y * canvas->cols];
+		}
+
+		last = NULL;
+		if (len < sizeof(row[x].glyph)) {
+			for (int i = 0; i < width; i++)
+				clearCell(canvas, y, x + i);
+
+			memcpy(row[x].glyph, str, len);
+			row[x].glyph[len] = '\0';
+			row[x].width = width;
+			row[x].attr = paint->attr;
+			row[x].type = paint->type;
+			last = &row[x];
+		}
+		str += len;
+
+		// text past the right edge goes on at the start of the next row,
+		// and stops at the last cell of the window
+		x += width;
+		if (x >= canvas->cols) {
+			if (++y >= rows) break;
+			x = 0;
+			row = &canvas->cells[(size_t) y * canvas->cols];
+		}
+	}
+}
+
+void cbonsaiCanvasPaintScene(struct cbonsaiCanvas* canvas, const struct cbonsaiScene* scene) {
+	for (const struct cbonsaiSceneChunk* chunk = scene->first; chunk; chunk = chunk->next) {
+		for (int i = 0; i < chunk->count; i++)
+			cbonsaiCanvasPaint(canvas, &chunk->paints[i]);
+	}
+}
+
+// the attribute of blank cells
+static const struct cbonsaiAttr plainAttr = { -1, 0, 0, 0 };
+
+static int sameAttr(const struct cbonsaiAttr* a, const struct cbonsaiAttr* b) {
+	return a->rgb == b->rgb && a->color == b->color && a->bold == b->bold;
+}
+
+// select graphic rendition for an attribute, in as many colors as the palette
+// takes. terminal colors are like curses pairs on a 256-color terminal: 1-7
+// are the normal colors, 8-15 the bright ones
+static void writeAttrs(FILE* fp, const struct cbonsaiPalette* palette, const struct cbonsaiAttr* attr) {
+	fputs(attr->bold ? "\033[0;1m" : "\033[0m", fp);
+	if (attr->rgb >= 0 && palette->colors > 256)
+		fprintf(fp, "\033[38;2;%d;%d;%dm", (attr->rgb >> 16) & 0xff, (attr->rgb >> 8) & 0xff, attr->rgb & 0xff);
+	else if (attr->rgb >= 0 && palette->colors == 256)
+		fprintf(fp, "\033[38;5;%dm", attr->color256);
+	else if (attr->color >= 1 && attr->color <= 7) fprintf(fp, "\033[3%dm", attr->color);
+	else if (attr->color >= 8 && attr->color <= 15) fprintf(fp, "\033[9%dm", attr->color - 8);
+}
+
+// whether a cell is the right half of a wide glyph
+static int isRightHalf(const struct cbonsaiCell* row, int x) {
+	return !row[x].glyph[0] && row[x].width == 0 && x > 0 && row[x - 1].width == 2;
+}
+
+// the end of a row, leaving out trailing blanks
+static int rowEnd(const struct cbonsaiCanvas* canvas, int y) {
+	const struct cbonsaiCell* row = &canvas->cells[(size_t) y * canvas->cols];
+	int end = canvas->cols;
+	while (end > 0 && (!row[end - 1].glyph[0] || !strcmp(row[end - 1].glyph, " ")))
+		end--;
+	return end;
+}
+
+// write cells x up to end of a row, starting and ending with default attributes
+static void writeRow(const struct cbonsaiPalette* palette, const struct cbonsaiCell* row, int x, int end, FILE* fp) {
+	const struct cbonsaiAttr* current = &plainAttr;
+	for (; x < end; x++) {
+		const struct cbonsaiCell* cell = &row[x];
+
+		// the right half of a wide glyph was written along with its left half
+		if (isRightHalf(row, x)) continue;
+
+		const struct cbonsaiAttr* attr = cell->glyph[0] ? &palette->attrs[cell->attr] : &plainAttr;
+		if (!sameAttr(attr, current)) {
+			current = attr;
+			writeAttrs(fp, palette, attr);
+		}
+		fputs(cell->glyph[0] ? cell->glyph : " ", fp);
+	}
+
+	if (!sameAttr(current, &plainAttr)) fputs("\033[0m", fp);
+}
+
+static int writeAnsi(const struct cbonsaiCanvas* canvas, int started, FILE* fp) {
+	const struct cbonsaiPalette* palette = canvasPalette(canvas);
+
+	for (int y = 0; y < canvas->rows; y++) {
+		const struct cbonsaiCell* row = &canvas->cells[(size_t) y * canvas->cols];
+		int end = rowEnd(canvas, y);
+
+		if (!started && end == 0) continue;
+		started = 1;
+
+		writeRow(palette, row, 0, end, fp);
+		fputc('\n', fp);
+	}
+
+	return ferror(fp) ? -1 : 0;
+}
+
+int cbonsaiCanvasWriteAnsi(const struct cbonsaiCanvas* canvas, FILE* fp) {
+	return writeAnsi(canvas, 0, fp);
+}
+
+int cbonsaiCanvasWriteAnsiScreen(const struct cbonsaiCanvas* canvas, FILE* fp) {
+	return writeAnsi(canvas, 1, fp);
+}
+
+int cbonsaiCanvasWriteAnsiSpan(const struct cbonsaiCanvas* canvas, int y, int x, int cols, FILE* fp) {
+	if (y < 0 || y >= canvas->rows) return 0;
+	if (x < 0) {
+		cols += x;
+		x = 0;
+	}
+	if (x + cols > canvas->cols) cols = canvas->cols - x;
+	if (cols <= 0) return 0;
+
+	const struct cbonsaiCell* row = &canvas->cells[(size_t) y * canvas->cols];
+
+	// start on the left half of a wide glyph
+	if (isRightHalf(row, x)) {
+		x--;
+		cols++;
+	}
+
+	fprintf(fp, "\033[%d;%dH", y + 1, x + 1);
+	writeRow(canvasPalette(canvas), row, x, x + cols, fp);
+	return ferror(fp) ? -1 : 0;
+}
+
+// the color of an attribute for formats that need it spelled out, or -1 for
+// the default color
+static int attrRgb(const struct cbonsaiAttr* attr) {
+	if (attr->rgb >= 0) return attr->rgb;
+	return attr->color ? xtermColors[attr->color & 15] : -1;
+}
+
+// the rows that are not blank, as the ANSI writer leaves out blank rows
+// above the tree; returns 0 if all are blank
+static int usedRows(const struct cbonsaiCanvas* canvas, int* first, int* last) {
+	*first = 0;
+	*last = canvas->rows - 1;
+	while (*first <= *last && rowEnd(canvas, *first) == 0) (*first)++;
+	while (*last >= *first && rowEnd(canvas, *last) == 0) (*last)--;
+	return *first <= *last;
+}
+
+static void writeEscaped(const char* str, FILE* fp) {
+	for (; *str; str++) {
+		switch (*str) {
+		case '&':
+			fputs("&amp;", fp);
+			break;
+		case '<':
+			fputs("&lt;", fp);
+			break;
+		case '>':
+			fputs("&gt;", fp);
+			break;
+		default:
+			fputc(*str, fp);
+		}
+	}
+}
+
+int cbonsaiCanvasWriteHtml(const struct cbonsaiCanvas* canvas, FILE* fp) {
+	const struct cbonsaiPalette* palette = canvasPalette(canvas);
+	int first, last;
+	if (!usedRows(canvas, &first, &last)) last = -1;
+	fputs("<pre class=\"cbonsai\">", fp);
+
+	for (int y = first; y <= last; y++) {
+		const struct cbonsaiCell* row = &canvas->cells[(size_t) y * canvas->cols];
+		int end = rowEnd(canvas, y);
+
+		// one span for each run of cells with the same colors
+		const struct cbonsaiAttr* current = NULL;
+		for (int x = 0; x < end; x++) {
+			const struct cbonsaiCell* cell = &row[x];
+			if (isRightHalf(row, x)) continue;
+
+			const struct cbonsaiAttr* attr = cell->glyph[0] ? &palette->attrs[cell->attr] : &plainAttr;
+			if (!current || !sameAttr(attr, current)) {
+				if (current && !sameAttr(current, &plainAttr)) fputs("</span>", fp);
+				current = attr;
+
+				int rgb = attrRgb(attr);
+				if (rgb >= 0) fprintf(fp, "<span style=\"color:#%06x%s\">", rgb, attr->bold ? ";font-weight:bold" : "");
+				else if (attr->bold) fputs("<span style=\"font-weight:bold\">", fp);
+			}
+
+			if (cell->glyph[0]) writeEscaped(cell->glyph, fp);
+			else fputc(' ', fp);
+		}
+		if (current && !sameAttr(current, &plainAttr)) fputs("</span>", fp);
+		fputc('\n', fp);
+	}
+
+	fputs("</pre>\n", fp);
+	return ferror(fp) ? -1 : 0;
+}
+
+// size of a cell in SVG user units, for a 14px monospace font
+#define SVG_CELL_WIDTH 8.4
+#define SVG_CELL_HEIGHT 17
+
+int cbonsaiCanvasWriteSvg(const struct cbonsaiCanvas* canvas, FILE* fp) {
+	const struct cbonsaiPalette* palette = canvasPalette(canvas);
+	int first, last;
+	int rows = usedRows(canvas, &first, &last) ? last - first + 1 : 0;
+
+	fprintf(fp, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%g\" height=\"%d\" "
+			"font-family=\"monospace\" font-size=\"14\" xml:space=\"preserve\">\n",
+			canvas->cols * SVG_CELL_WIDTH, rows * SVG_CELL_HEIGHT);
+
+	for (int y = first; y < first + rows; y++) {
+		const struct cbonsaiCell* row = &canvas->cells[(size_t) y * canvas->cols];
+		int end = rowEnd(canvas, y);
+		double baseline = (y - first + 1) * SVG_CELL_HEIGHT - 4;
+
+		// one text element for each run of painted cells with the same
+		// colors. wide glyphs get their own, as fonts rarely draw them at
+		// exactly two cells
+		for (int x = 0; x < end;) {
+			const struct cbonsaiCell* cell = &row[x];
+			if (!cell->glyph[0] || !strcmp(cell->glyph, " ")) {
+				x++;
+				continue;
+			}
+
+			const struct cbonsaiAttr* attr = &palette->attrs[cell->attr];
+			int rgb = attrRgb(attr);
+			fprintf(fp, "<text x=\"%g\" y=\"%g\" fill=\"", x * SVG_CELL_WIDTH, baseline);
+			if (rgb >= 0) fprintf(fp, "#%06x", rgb);
+			else fputs("currentColor", fp);
+			fprintf(fp, "\"%s>", attr->bold ? " font-weight=\"bold\"" : "");
+
+			int run = x;
+			do {
+				writeEscaped(row[run].glyph, fp);
+				run += row[run].width > 1 ? row[run].width : 1;
+			} while (run < end && cell->width < 2 && row[run].width == 1 && row[run].glyph[0]
+					&& sameAttr(&palette->attrs[row[run].attr], attr));
+
+			fputs("</text>\n", fp);
+			x = run;
+		}
+	}
+
+	fputs("</svg>\n", fp);
+	return ferror(fp) ? -1 : 0;
+}
+
+/* base */
+
+#define POT CBONSAI_ATTR(cbonsaiRolePot, 0, 0)
+#define MOSS CBONSAI_ATTR(cbonsaiRoleMoss, 0, 0)
+#define STUMP CBONSAI_ATTR(cbonsaiRoleStump, 0, 0)
+
+// the big base is highlighted
+#define BOLD CBONSAI_LEVELS
+
+static const struct cbonsaiBaseSegment bigBase[] = {
+	{ 0, 0, POT + BOLD, ":" },
+	{ 0, 1, MOSS + BOLD, "___________" },
+	{ 0, 12, STUMP + BOLD, "./~~~\\." },
+	{ 0, 19, MOSS + BOLD, "___________" },
+	{ 0, 30, POT + BOLD, ":" },
+	{ 1, 0, POT + BOLD, " \\                           / " },
+	{ 2, 0, POT + BOLD, "  \\_________________________/ " },
+	{ 3, 0, POT + BOLD, "  (_)                     (_)" },
+	{ 0, 0, 0, NULL },
+};
+
+static const struct cbonsaiBaseSegment smallBase[] = {
+	{ 0, 0, POT, "(" },
+	{ 0, 1, MOSS, "---" },
+	{ 0, 4, STUMP, "./~~~\\." },
+	{ 0, 11, MOSS, "---" },
+	{ 0, 14, POT, ")" },
+	{ 1, 0, POT, " (           ) " },
+	{ 2, 0, POT, "  (_________)  " },
+	{ 0, 0, 0, NULL },
+};
+
+#undef POT
+#undef MOSS
+#undef STUMP
+#undef BOLD
+
+const struct cbonsaiBaseSegment* cbonsaiBase(int baseType, int* rows, int* cols) {
+	switch (baseType) {
+	case 1:
+		*rows = 4;
+		*cols = 31;
+		return bigBase;
+	case 2:
+		*rows = 3;
+		*cols = 15;
+		return smallBase;
+	}
+
+	*rows = 0;
+	*cols = 0;
+	return NULL;
+}
+
+void cbonsaiCanvasPaintBase(struct cbonsaiCanvas* canvas, int baseType) {
+	int rows, cols;
+	const struct cbonsaiBaseSegment* segment = cbonsaiBase(baseType, &rows, &cols);
+
+	for (; segment && segment->str; segment++) {
+		struct cbonsaiPaint paint = {
+			.y = 1 + segment->y,
+			.x = segment->x - (cols / 2),
+			.str = segment->str,
+			.attr = segment->attr,
+			.type = cbonsaiNoBranch,
+		};
+		cbonsaiCanvasPaint(canvas, &paint);
+	}
+}
+
+/* leaves */
+
+int cbonsaiGlyphWidth(const char* str) {
+	mbstate_t state;
+	memset(&state, 0, sizeof(state));
+
+	// every character has to be printable, not only the first
+	int first = -1;
+	while (*str) {
+		wchar_t wc;
+		size_t len = mbrtowc(&wc, str, MB_LEN_MAX, &state);
+		if (len == (size_t) -1 || len == (size_t) -2) return -1;
+
+		int width = wcwidth(wc);
+		if (width < 0 || (first < 0 && width == 0)) return -1;
+		if (first < 0) first = width;
+		str += len;
+	}
+	return first;
+}
+
+int cbonsaiLeafSetInit(struct cbonsaiLeafSet* set, const char* const* leaves, const double* weights, int count, struct cbonsaiArena* arena) {
+	if (count <= 0) return -1;
+
+	set->leaves = leaves;
+	set->count = count;
+	set->widths = cbonsaiArenaAlloc(arena, count * sizeof(*set->widths));
+	set->cutoffs = cbonsaiArenaAlloc(arena, count * sizeof(*set->cutoffs));
+	set->aliases = cbonsaiArenaAlloc(arena, count * sizeof(*set->aliases));
+
+	// scratch space, left in the arena
+	double* scaled = cbonsaiArenaAlloc(arena, count * sizeof(*scaled));
+	int* small = cbonsaiArenaAlloc(arena, count * sizeof(*small));
+	int* large = cbonsaiArenaAlloc(arena, count * sizeof(*large));
+	if (!set->widths || !set->cutoffs || !set->aliases || !scaled || !small || !large) return -1;
+
+	double total = 0;
+	for (int i = 0; i < count; i++) {
+		int width = cbonsaiGlyphWidth(leaves[i]);
+		double weight = weights ? weights[i] : 1;
+		if (width < 0 || !(weight >= 0)) return -1;
+
+		set->widths[i] = width;
+		total += weight;
+	}
+	if (!(total > 0)) return -1;
+
+	// split the weights into count columns of equal height, each holding
+	// (part of) its own leaf and the rest of one other, its alias
+	int smallCount = 0, largeCount = 0;
+	for (int i = 0; i < count; i++) {
+		scaled[i] = (weights ? weights[i] : 1) * count / total;
+		if (scaled[i] < 1) small[smallCount++] = i;
+		else large[largeCount++] = i;
+	}
+
+	// cutoffs are in the units of chooseLeaf(): nextRandom() / count
+	double range = 2147483648.0 / count;
+	while (smallCount > 0 && largeCount > 0) {
+		int less = small[--smallCount];
+		int more = large[--largeCount];
+
+		set->cutoffs[less] = scaled[less] * range;
+		set->aliases[less] = more;
+
+		scaled[more] -= 1 - scaled[less];
+		if (scaled[more] < 1) small[smallCount++] = more;
+		else large[largeCount++] = more;
+	}
+
+	// what is left is full, give or take rounding
+	while (largeCount > 0) {
+		int full = large[--largeCount];
+		set->cutoffs[full] = UINT32_MAX;
+		set->aliases[full] = full;
+	}
+	while (smallCount > 0) {
+		int full = small[--smallCount];
+		set->cutoffs[full] = UINT32_MAX;
+		set->aliases[full] = full;
+	}
+	return 0;
+}
+
+/* growth */
+
+// trees drawn from a single stream use the additive feedback generator of
+// glibc's rand(), seeded like srand(), so that a seed still grows the tree
+// it always has, while the tree keeps the generator to itself
+static void seedClassic(struct cbonsaiTree* tree, uint32_t seed) {
+	int32_t* r = tree->classic;
+	r[0] = seed ? (int32_t) seed : 1;
+	for (int i = 1; i < 31; i++) {
+		// 16807 * r[i - 1] % 2147483647, without overflowing
+		int32_t hi = r[i - 1] / 127773;
+		int32_t lo = r[i - 1] % 127773;
+		r[i] = 16807 * lo - 2836 * hi;
+		if (r[i] < 0) r[i] += 2147483647;
+	}
+	tree->classicFront = 3;
+	tree->classicRear = 0;
+}
+
+static int nextClassic(struct cbonsaiTree* tree) {
+	int32_t* r = tree->classic;
+	uint32_t value = (uint32_t) r[tree->classicFront] + (uint32_t) r[tree->classicRear];
+	r[tree->classicFront] = (int32_t) value;
+	tree->classicFront = (tree->classicFront + 1) % 31;
+	tree->classicRear = (tree->classicRear + 1) % 31;
+	return value >> 1;
+}
+
+// next number from the tree's own random number generator, in the range of
+// rand(). branches with streams of their own use splitmix64
+static int nextRandom(struct cbonsaiTree* tree) {
+	if (!tree->conf->threads && !tree->tips)
+		return nextClassic(tree);
+
+	uint64_t z = (tree->rng += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return (int) ((z ^ (z >> 31)) >> 33);
+}
+
+// roll (randomize) a given die
+static void roll(struct cbonsaiTree* tree, int *dice, int mod) { *dice = nextRandom(tree) % mod; }
+
+static double secondsSince(const struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// the part of the step and time budgets kept for trunks already growing:
+// other branches stop once this little is left
+#define TRUNK_RESERVE 0.1
+
+// fraction of the tightest budget on steps, steps or time, still left
+static double stepsLeft(const struct cbonsaiTree *tree) {
+	const struct cbonsaiConfig *conf = tree->conf;
+	double left = 1;
+
+	if (conf->maxSteps > 0) {
+		double stepsLeft = 1 - (double) tree->stats.steps / conf->maxSteps;
+		if (stepsLeft < left) left = stepsLeft;
+	}
+
+	if (conf->timeLimit > 0) {
+		double timeLeft = 1 - secondsSince(&tree->startTime) / conf->timeLimit;
+		if (timeLeft < left) left = timeLeft;
+	}
+
+	return left;
+}
+
+// fraction of the tightest growth budget that is still left, 1 if unlimited
+static double budgetLeft(const struct cbonsaiTree *tree) {
+	const struct cbonsaiConfig *conf = tree->conf;
+	double left = stepsLeft(tree);
+
+	if (conf->maxBranches > 0) {
+		double branchesLeft = 1 - (double) tree->stats.branches / conf->maxBranches;
+		if (branchesLeft < left) left = branchesLeft;
+	}
+
+	return left;
+}
+
+// decide whether a new branch of the given type fits in the budget.
+// as the budget runs low, leaves are pruned first, then dying branches,
+// then new shoots and trunks, so that what is left goes to existing trunks
+static int withinBudget(struct cbonsaiTree *tree, enum cbonsaiBranchType type) {
+	double reserve = 0;
+	switch (type) {
+	case cbonsaiDead:
+		reserve = 0.5;
+		break;
+	case cbonsaiDying:
+		reserve = 0.25;
+		break;
+	default:
+		reserve = TRUNK_RESERVE;
+		break;
+	}
+
+	// the first trunk always starts, however small the budget
+	double left = budgetLeft(tree);
+	if (tree->stats.branches == 0 || left > reserve)
+		return 1;
+
+	tree->stats.pruned++;
+	if (left <= 0) tree->stats.budget = cbonsaiBudgetSpent;
+	else if (tree->stats.budget == cbonsaiBudgetOk) tree->stats.budget = cbonsaiBudgetLow;
+	return 0;
+}
+
+// based on type of tree, determine what color a branch should be: its role,
+// whether it is highlighted, and where it is on the palette's gradient
+static void chooseColor(struct cbonsaiTree *tree, enum cbonsaiBranchType type, int depth, int age, struct cbonsaiPaint *paint) {
+	const struct cbonsaiPalette *palette = tree->conf->palette;
+	int level = 0;
+	if (palette && palette->gradient == cbonsaiGradientDepth)
+		level = depth;
+	else if (palette && palette->gradient == cbonsaiGradientAge)
+		level = age * CBONSAI_LEVELS / (tree->conf->lifeStart + 1);
+	if (level < 0) level = 0;
+	if (level >= CBONSAI_LEVELS) level = CBONSAI_LEVELS - 1;
+
+	switch(type) {
+	case cbonsaiTrunk:
+	case cbonsaiShootLeft:
+	case cbonsaiShootRight:
+		paint->attr = CBONSAI_ATTR(cbonsaiRoleWood, nextRandom(tree) % 2 == 0, level);
+		break;
+
+	case cbonsaiDying:
+		paint->attr = CBONSAI_ATTR(cbonsaiRoleDying, nextRandom(tree) % 10 == 0, level);
+		break;
+
+	case cbonsaiDead:
+		paint->attr = CBONSAI_ATTR(cbonsaiRoleDead, nextRandom(tree) % 3 == 0, level);
+		break;
+
+	case cbonsaiNoBranch:
+		break;
+	}
+}
+
+// determine change in X and Y coordinates of a given branch
+static void setDeltas(struct cbonsaiTree *tree, enum cbonsaiBranchType type, int life, int age, int multiplier, int *returnDx, int *returnDy) {
+	int dx = 0;
+	int dy = 0;
+	int dice;
+	switch (type) {
+	case cbonsaiTrunk: // trunk
+
+		// new or dead trunk
+		if (age <= 2 || life < 4) {
+			dy = 0;
+			dx = (nextRandom(tree) % 3) - 1;
+		}
+		// young trunk should grow wide
+		else if (age < (multiplier * 3)) {
+
+			// every (multiplier * 0.8) steps, raise tree to next level
+			if (age % (int) (multiplier * 0.5) == 0) dy = -1;
+			else dy = 0;
+
+			roll(tree, &dice, 10);
+			if (dice >= 0 && dice <=0) dx = -2;
+			else if (dice >= 1 && dice <= 3) dx = -1;
+			else if (dice >= 4 && dice <= 5) dx = 0;
+			else if (dice >= 6 && dice <= 8) dx = 1;
+			else if (dice >= 9 && dice <= 9) dx = 2;
+		}
+		// middle-aged trunk
+		else {
+			roll(tree, &dice, 10);
+			if (dice > 2) dy = -1;
+			else dy = 0;
+			dx = (nextRandom(tree) % 3) - 1;
+		}
+		break;
+
+	case cbonsaiShootLeft: // left shoot: trend left and little vertical movement
+		roll(tree, &dice, 10);
+		if (dice >= 0 && dice <= 1) dy = -1;
+		else if (dice >= 2 && dice <= 7) dy = 0;
+		else if (dice >= 8 && dice <= 9) dy = 1;
+
+		roll(tree, &dice, 10);
+		if (dice >= 0 && dice <=1) dx = -2;
+		else if (dice >= 2 && dice <= 5) dx = -1;
+		else if (dice >= 6 && dice <= 8) dx = 0;
+		else if (dice >= 9 && dice <= 9) dx = 1;
+		break;
+
+	case cbonsaiShootRight: // right shoot: trend right and little vertical movement
+		roll(tree, &dice, 10);
+		if (dice >= 0 && dice <= 1) dy = -1;
+		else if (dice >= 2 && dice <= 7) dy = 0;
+		else if (dice >= 8 && dice <= 9) dy = 1;
+
+		roll(tree, &dice, 10);
+		if (dice >= 0 && dice <=1) dx = 2;
+		else if (dice >= 2 && dice <= 5) dx = 1;
+		else if (dice >= 6 && dice <= 8) dx = 0;
+		else if (dice >= 9 && dice <= 9) dx = -1;
+		break;
+
+	case cbonsaiDying: // dying: discourage vertical growth(?); trend left/right (-3,3)
+		roll(tree, &dice, 10);
+		if (dice >= 0 && dice <=1) dy = -1;
+		else if (dice >= 2 && dice <=8) dy = 0;
+		else if (dice >= 9 && dice <=9) dy = 1;
+
+		roll(tree, &dice, 15);
+		if (dice >= 0 && dice <=0) dx = -3;
+		else if (dice >= 1 && dice <= 2) dx = -2;
+		else if (dice >= 3 && dice <= 5) dx = -1;
+		else if (dice >= 6 && dice <= 8) dx = 0;
+		else if (dice >= 9 && dice <= 11) dx = 1;
+		else if (dice >= 12 && dice <= 13) dx = 2;
+		else if (dice >= 14 && dice <= 14) dx = 3;
+		break;
+
+	case cbonsaiDead: // dead: fill in surrounding area
+		roll(tree, &dice, 10);
+		if (dice >= 0 && dice <= 2) dy = -1;
+		else if (dice >= 3 && dice <= 6) dy = 0;
+		else if (dice >= 7 && dice <= 9) dy = 1;
+		dx = (nextRandom(tree) % 3) - 1;
+		break;
+
+	case cbonsaiNoBranch:
+		break;
+	}
+
+	*returnDx = dx;
+	*returnDy = dy;
+}
+
+// choose a weighted leaf with a single random number: its remainder picks a
+// column of the alias table, and its quotient whether to keep the column.
+// with equal weights, this is nextRandom() % count
+static int chooseLeaf(struct cbonsaiTree *tree, const struct cbonsaiLeafSet *set) {
+	unsigned r = nextRandom(tree);
+	int column = r % set->count;
+	return r / set->count < set->cutoffs[column] ? column : set->aliases[column];
+}
+
+static void chooseString(struct cbonsaiTree *tree, enum cbonsaiBranchType type, int life, int dx, int dy, struct cbonsaiPaint *paint) {
+	const char* branchStr = "?";	// fallback character
+	int width = 1;
+
+	if (life < 4) type = cbonsaiDying;
+
+	switch(type) {
+	case cbonsaiTrunk:
+		if (dy == 0) branchStr = "/~";
+		else if (dx < 0) branchStr = "\\|";
+		else if (dx == 0) branchStr = "/|\\";
+		else if (dx > 0) branchStr = "|/";
+		break;
+	case cbonsaiShootLeft:
+		if (dy > 0) branchStr = "\\";
+		else if (dy == 0) branchStr = "\\_";
+		else if (dx < 0) branchStr = "\\|";
+		else if (dx == 0) branchStr = "/|";
+		else if (dx > 0) branchStr = "/";
+		break;
+	case cbonsaiShootRight:
+		if (dy > 0) branchStr = "/";
+		else if (dy == 0) branchStr = "_/";
+		else if (dx < 0) branchStr = "\\|";
+		else if (dx == 0) branchStr = "/|";
+		else if (dx > 0) branchStr = "/";
+		break;
+	case cbonsaiDying:
+	case cbonsaiDead:
+		branchStr = "&";
+		if (tree->conf->leafSet) {
+			int leaf = chooseLeaf(tree, tree->conf->leafSet);
+			branchStr = tree->conf->leafSet->leaves[leaf];
+			width = tree->conf->leafSet->widths[leaf];
+		}
+		else if (tree->conf->leavesSize > 0) {
+			branchStr = tree->conf->leaves[nextRandom(tree) % tree->conf->leavesSize];
+			width = 0;
+		}
+		break;
+	case cbonsaiNoBranch:
+		break;
+	}
+
+	paint->str = branchStr;
+	paint->width = width;
+}
+
+static int branch(struct cbonsaiTree *tree, int y, int x, enum cbonsaiBranchType type, int life, int depth);
+static int queueBranch(struct cbonsaiWorker *worker, int y, int x, enum cbonsaiBranchType type, int life, int depth, uint64_t seed);
+static int addTip(struct cbonsaiTree *tree, int y, int x, enum cbonsaiBranchType type, int life, int depth, uint64_t seed);
+
+// start a stream of random numbers, for a tree or for a branch of its own
+static void startStream(struct cbonsaiTree *tree, uint64_t seed) {
+	tree->rng = seed;
+	if (!tree->conf->threads && !tree->tips) {
+		seedClassic(tree, seed);
+		for (int i = 0; i < 310; i++)
+			nextClassic(tree);
+	}
+	tree->shootCounter = nextRandom(tree);
+}
+
+// the seed of the nth branch spawned by a branch, from the state of its stream
+static uint64_t streamSeed(uint64_t rng, unsigned n) {
+	uint64_t z = rng ^ ((n + 1) * 0xd1b54a32d192ed03ULL);
+	z = (z ^ (z >> 33)) * 0xff51afd7ed558ccdULL;
+	z = (z ^ (z >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+	return z ^ (z >> 33);
+}
+
+// grow a branch spawned by another. with a stream for each branch, shoots
+// and trunks can be grown by another thread, branches of a tree growing in
+// installments become tips, and the rest are grown right away from their own
+// streams, leaving the parent's stream where it was
+static int spawn(struct cbonsaiTree *tree, struct cbonsaiTip *parent, enum cbonsaiBranchType type, int life) {
+	int y = parent->y;
+	int x = parent->x;
+	int depth = parent->depth + 1;
+	if (!tree->conf->threads && !tree->tips)
+		return branch(tree, y, x, type, life, depth);
+
+	uint64_t seed = streamSeed(tree->rng, parent->spawned++);
+	if (tree->tips) {
+		if (addTip(tree, y, x, type, life, depth, seed) != 0) tree->stopped = 1;
+		return 1;
+	}
+	if (tree->worker && type != cbonsaiDying && type != cbonsaiDead
+			&& queueBranch(tree->worker, y, x, type, life, depth, seed) == 0)
+		return 1;
+
+	uint64_t rng = tree->rng;
+	unsigned shootCounter = tree->shootCounter;
+	startStream(tree, seed);
+	int grown = branch(tree, y, x, type, life, depth);
+	tree->rng = rng;
+	tree->shootCounter = shootCounter;
+	return grown;
+}
+
+// count a new branch and pass it to onBranch
+static void startBranch(struct cbonsaiTree *tree, struct cbonsaiTip *tip, enum cbonsaiBranchType type, int y, int x, int life, int depth) {
+	memset(tip, 0, sizeof(*tip));
+	tip->id = tree->stats.branches;
+	tip->y = y;
+	tip->x = x;
+	tip->life = life;
+	tip->depth = depth;
+	tip->shootCooldown = tree->conf->multiplier;
+	tip->type = type;
+	tree->stats.branches++;
+
+	struct cbonsaiBranch started = { tip->id, tree->branch, y, x, life, depth, type };
+	if (tree->onBranch) tree->onBranch(tree, &started);
+}
+
+// take a step of a branch. returns nonzero when the branch has to stop
+static int growStep(struct cbonsaiTree *tree, struct cbonsaiTip *tip) {
+	const struct cbonsaiConfig *conf = tree->conf;
+	enum cbonsaiBranchType type = tip->type;
+
+	if (tree->stopped || (tree->onStep && tree->onStep(tree))) {
+		tree->stopped = 1;
+		return 1;
+	}
+
+	// no step is taken past the step and time budgets. the last of them is
+	// kept for trunks still growing, so that they rarely get cut off
+	double left = stepsLeft(tree);
+	if (left <= 0) {
+		tree->stats.budget = cbonsaiBudgetSpent;
+		return 1;
+	}
+	if (left <= TRUNK_RESERVE && type != cbonsaiTrunk) {
+		if (tree->stats.budget == cbonsaiBudgetOk) tree->stats.budget = cbonsaiBudgetLow;
+		return 1;
+	}
+	tree->stats.steps++;
+
+	int life = --tip->life;		// decrement remaining life counter
+	int age = conf->lifeStart - life;
+
+	setDeltas(tree, type, life, age, conf->multiplier, &tip->dx, &tip->dy);
+
+	if (tip->dy > 0 && tip->y >= 0) tip->dy--; // reduce dy if too close to the ground
+
+	// near-dead branch should branch into a lot of leaves
+	if (life < 3)
+		spawn(tree, tip, cbonsaiDead, life);
+
+	// dying trunk should branch into a lot of leaves
+	else if (type == cbonsaiTrunk && life < (conf->multiplier + 2))
+		spawn(tree, tip, cbonsaiDying, life);
+
+	// dying shoot should branch into a lot of leaves
+	else if ((type == cbonsaiShootLeft || type == cbonsaiShootRight) && life < (conf->multiplier + 2))
+		spawn(tree, tip, cbonsaiDying, life);
+
+	// trunks should re-branch if not close to ground AND either randomly, or upon every <multiplier> steps
+	else if (type == cbonsaiTrunk && (((nextRandom(tree) % 3) == 0) || (life % conf->multiplier == 0))) {
+
+		// if trunk is branching and not about to die, create another trunk with random life
+		if ((nextRandom(tree) % 8 == 0) && life > 7) {
+			tip->shootCooldown = conf->multiplier * 2;	// reset shoot cooldown
+			spawn(tree, tip, cbonsaiTrunk, life + (nextRandom(tree) % 5 - 2));
+		}
+
+		// otherwise create a shoot
+		else if (tip->shootCooldown <= 0) {
+			tip->shootCooldown = conf->multiplier * 2;	// reset shoot cooldown
+
+			int shootLife = (life + conf->multiplier);
+
+			// first shoot is randomly directed
+			tree->shootCounter++;
+
+			// create shoot, counting it unless the budget prunes it
+			if (spawn(tree, tip, (tree->shootCounter % 2) + 1, shootLife))
+				tree->stats.shoots++;
+		}
+	}
+	tip->shootCooldown--;
+
+	if (tree->stopped) return 1;
+
+	// move in x and y directions
+	tip->x += tip->dx;
+	tip->y += tip->dy;
+
+	tree->dx = tip->dx;
+	tree->dy = tip->dy;
+	tree->shootCooldown = tip->shootCooldown;
+
+	struct cbonsaiPaint paint = { .y = tip->y, .x = tip->x, .type = type };
+	chooseColor(tree, type, tip->depth, age, &paint);
+
+	// choose string to use for this branch
+	chooseString(tree, type, life, tip->dx, tip->dy, &paint);
+
+	if (tree->onPaint) tree->onPaint(tree, &paint);
+	return 0;
+}
+
+// depth counts the branches this one grew out of. returns 0 if the budget
+// pruned the branch
+static int branch(struct cbonsaiTree *tree, int y, int x, enum cbonsaiBranchType type, int life, int depth) {
+	if (!withinBudget(tree, type)) return 0;
+
+	int parent = tree->branch;
+	struct cbonsaiTip tip;
+	startBranch(tree, &tip, type, y, x, life, depth);
+	tree->branch = tip.id;
+
+	while (tip.life > 0 && growStep(tree, &tip) == 0);
+
+	tree->branch = parent;
+	return 1;
+}
+
+void cbonsaiGrowTree(struct cbonsaiTree* tree) {
+	memset(&tree->stats, 0, sizeof(tree->stats));
+	tree->stats.budget = cbonsaiBudgetOk;
+	tree->dx = 0;
+	tree->dy = 0;
+	tree->shootCooldown = 0;
+	tree->stopped = 0;
+	tree->branch = -1;
+	startStream(tree, tree->conf->seed);
+	clock_gettime(CLOCK_MONOTONIC, &tree->startTime);
+
+	// recursively grow tree trunk and branches, starting from the base of the trunk
+	branch(tree, 0, 0, cbonsaiTrunk, tree->conf->lifeStart, 0);
+}
+
+// where cbonsaiGrow() sends each painted step
+struct growTarget {
+	struct cbonsaiCanvas* canvas;
+	struct cbonsaiScene* scene;
+	int full;
+};
+
+static void paintTarget(struct cbonsaiTree* tree, const struct cbonsaiPaint* paint) {
+	struct growTarget* target = tree->userData;
+
+	if (target->canvas)
+		cbonsaiCanvasPaint(target->canvas, paint);
+	if (target->scene && !target->full && cbonsaiSceneAdd(target->scene, paint) != 0)
+		target->full = 1;
+}
+
+/* parallel growth */
+
+// tasks a worker can have queued; past that, it grows branches itself
+#define WORKER_QUEUE 4096
+
+// a branch grown as a task, by any thread
+struct branchTask {
+	int y;
+	int x;
+	enum cbonsaiBranchType type;
+	int life;
+	int depth;
+	uint64_t seed;
+
+	// what it painted, including branches grown along with it, and the
+	// tasks it spawned, in order, each before the paint it was spawned at
+	struct cbonsaiScene paints;
+	struct branchTask* firstChild;
+	struct branchTask* lastChild;
+	struct branchTask* next;
+	size_t spawnedAt;
+};
+
+struct parallelGrowth {
+	struct cbonsaiWorker* workers;
+	int count;
+	atomic_int pending;	// tasks queued or running
+
+	// idle workers wait on wake until a task is queued, counted by queued,
+	// or until none are pending. idle counts them, so that queueing a task
+	// only takes the lock when one of them may be waiting
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	atomic_uint queued;
+	atomic_int idle;
+};
+
+struct cbonsaiWorker {
+	struct cbonsaiTree tree;	// this thread's stream and stats
+	struct cbonsaiArena arena;	// tasks, and what they painted
+	struct branchTask* current;
+	struct parallelGrowth* growth;
+	int failed;
+
+	// a deque of tasks: the worker takes the newest, thieves the oldest
+	pthread_mutex_t lock;
+	struct branchTask* queue[WORKER_QUEUE];
+	unsigned oldest;
+	unsigned newest;
+};
+
+static void recordPaint(struct cbonsaiTree* tree, const struct cbonsaiPaint* paint) {
+	struct cbonsaiWorker* worker = tree->worker;
+	if (cbonsaiSceneAdd(&worker->current->paints, paint) != 0)
+		worker->failed = 1;
+}
+
+static void runTask(struct cbonsaiWorker* worker, struct branchTask* task) {
+	struct cbonsaiTree* tree = &worker->tree;
+	struct branchTask* spawner = worker->current;
+	uint64_t rng = tree->rng;
+	unsigned shootCounter = tree->shootCounter;
+
+	worker->current = task;
+	cbonsaiSceneInit(&task->paints, &worker->arena);
+	startStream(tree, task->seed);
+	branch(tree, task->y, task->x, task->type, task->life, task->depth);
+
+	worker->current = spawner;
+	tree->rng = rng;
+	tree->shootCounter = shootCounter;
+
+	// the last task wakes every idle worker, to let them return
+	struct parallelGrowth* growth = worker->growth;
+	if (atomic_fetch_sub(&growth->pending, 1) == 1) {
+		pthread_mutex_lock(&growth->lock);
+		pthread_cond_broadcast(&growth->wake);
+		pthread_mutex_unlock(&growth->lock);
+	}
+}
+
+// hand a branch to whichever thread gets to it first. returns -1 if there
+// is no memory for it, in which case the caller grows it
+static int queueBranch(struct cbonsaiWorker *worker, int y, int x, enum cbonsaiBranchType type, int life, int depth, uint64_t seed) {
+	struct branchTask* task = cbonsaiArenaAlloc(&worker->arena, sizeof(*task));
+	if (!task) return -1;
+
+	memset(task, 0, sizeof(*task));
+	task->y = y;
+	task->x = x;
+	task->type = type;
+	task->life = life;
+	task->depth = depth;
+	task->seed = seed;
+
+	struct branchTask* spawner = worker->current;
+	task->spawnedAt = spawner->paints.count;
+	if (spawner->lastChild) spawner->lastChild->next = task;
+	else spawner->firstChild = task;
+	spawner->lastChild = task;
+
+	atomic_fetch_add(&worker->growth->pending, 1);
+	pthread_mutex_lock(&worker->lock);
+	int queued = worker->newest - worker->oldest < WORKER_QUEUE;
+	if (queued) worker->queue[worker->newest++ % WORKER_QUEUE] = task;
+	pthread_mutex_unlock(&worker->lock);
+
+	if (!queued) runTask(worker, task);
+	else {
+		struct parallelGrowth* growth = worker->growth;
+		atomic_fetch_add(&growth->queued, 1);
+		if (atomic_load(&growth->idle) > 0) {
+			pthread_mutex_lock(&growth->lock);
+			pthread_cond_signal(&growth->wake);
+			pthread_mutex_unlock(&growth->lock);
+		}
+	}
+	return 0;
+}
+
+static struct branchTask* takeTask(struct cbonsaiWorker* worker, int newest) {
+	struct branchTask* task = NULL;
+	pthread_mutex_lock(&worker->lock);
+	if (worker->newest != worker->oldest)
+		task = worker->queue[(newest ? --worker->newest : worker->oldest++) % WORKER_QUEUE];
+	pthread_mutex_unlock(&worker->lock);
+	return task;
+}
+
+static void* work(void* arg) {
+	struct cbonsaiWorker* worker = arg;
+	struct parallelGrowth* growth = worker->growth;
+	int self = worker - growth->workers;
+
+	while (atomic_load(&growth->pending) > 0) {
+		unsigned queued = atomic_load(&growth->queued);
+		struct branchTask* task = takeTask(worker, 1);
+		for (int i = 1; !task && i < growth->count; i++)
+			task = takeTask(&growth->workers[(self + i) % growth->count], 0);
+
+		if (task) {
+			runTask(worker, task);
+			continue;
+		}
+
+		// nothing to take: sleep until a task is queued after the queues
+		// were looked through, or the last one is done. a task queued
+		// before this worker counts as idle is seen through queued
+		pthread_mutex_lock(&growth->lock);
+		atomic_fetch_add(&growth->idle, 1);
+		while (atomic_load(&growth->queued) == queued && atomic_load(&growth->pending) > 0)
+			pthread_cond_wait(&growth->wake, &growth->lock);
+		atomic_fetch_sub(&growth->idle, 1);
+		pthread_mutex_unlock(&growth->lock);
+	}
+	return NULL;
+}
+
+// paint a task in the order growing it on one thread would have
+static void paintTask(struct cbonsaiTree* tree, const struct branchTask* task) {
+	const struct branchTask* child = task->firstChild;
+	size_t painted = 0;
+
+	for (const struct cbonsaiSceneChunk* chunk = task->paints.first; chunk; chunk = chunk->next) {
+		for (int i = 0; i < chunk->count; i++, painted++) {
+			for (; child && child->spawnedAt == painted; child = child->next)
+				paintTask(tree, child);
+			tree->onPaint(tree, &chunk->paints[i]);
+		}
+	}
+	for (; child; child = child->next)
+		paintTask(tree, child);
+}
+
+// grow a tree on several threads, then paint it through tree->onPaint
+static int growParallel(struct cbonsaiTree* tree) {
+	const struct cbonsaiConfig* conf = tree->conf;
+	struct parallelGrowth growth;
+	growth.count = conf->threads;
+	growth.workers = calloc(growth.count, sizeof(*growth.workers));
+	pthread_t* threads = calloc(growth.count, sizeof(*threads));
+	if (!growth.workers || !threads) {
+		free(growth.workers);
+		free(threads);
+		return -1;
+	}
+
+	for (int i = 0; i < growth.count; i++) {
+		struct cbonsaiWorker* worker = &growth.workers[i];
+		worker->tree.conf = conf;
+		worker->tree.onPaint = recordPaint;
+		worker->tree.worker = worker;
+		worker->growth = &growth;
+		cbonsaiArenaInit(&worker->arena, NULL, 0);
+		worker->arena.grow = malloc;
+		pthread_mutex_init(&worker->lock, NULL);
+	}
+
+	// the trunk is the first task, of the first worker
+	struct branchTask root;
+	memset(&root, 0, sizeof(root));
+	root.type = cbonsaiTrunk;
+	root.life = conf->lifeStart;
+	root.seed = conf->seed;
+	atomic_init(&growth.pending, 1);
+	atomic_init(&growth.queued, 0);
+	atomic_init(&growth.idle, 0);
+	pthread_mutex_init(&growth.lock, NULL);
+	pthread_cond_init(&growth.wake, NULL);
+	growth.workers[0].queue[growth.workers[0].newest++] = &root;
+
+	int started = 1;
+	while (started < growth.count && pthread_create(&threads[started], NULL, work, &growth.workers[started]) == 0)
+		started++;
+	work(&growth.workers[0]);
+	for (int i = 1; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	int failed = 0;
+	for (int i = 0; i < growth.count; i++) {
+		const struct cbonsaiStats* stats = &growth.workers[i].tree.stats;
+		tree->stats.branches += stats->branches;
+		tree->stats.shoots += stats->shoots;
+		tree->stats.steps += stats->steps;
+		failed |= growth.workers[i].failed;
+	}
+	if (!failed) paintTask(tree, &root);
+
+	for (int i = 0; i < growth.count; i++) {
+		cbonsaiArenaRelease(&growth.workers[i].arena, free);
+		pthread_mutex_destroy(&growth.workers[i].lock);
+	}
+	pthread_mutex_destroy(&growth.lock);
+	pthread_cond_destroy(&growth.wake);
+	free(growth.workers);
+	free(threads);
+	return failed ? -1 : 0;
+}
+
+int cbonsaiGrow(const struct cbonsaiConfig* conf, struct cbonsaiCanvas* canvas, struct cbonsaiScene* scene, struct cbonsaiStats* stats) {
+	struct growTarget target = { canvas, scene, 0 };
+
+	struct cbonsaiTree tree;
+	memset(&tree, 0, sizeof(tree));
+	tree.conf = conf;
+	tree.onPaint = paintTarget;
+	tree.userData = &target;
+
+	if (canvas) cbonsaiCanvasClear(canvas);
+
+	// budgets depend on the order branches grow in, so they keep to one thread
+	int failed = 0;
+	if (conf->threads > 1 && conf->maxSteps <= 0 && conf->maxBranches <= 0 && conf->timeLimit <= 0) {
+		tree.stats.budget = cbonsaiBudgetOk;
+		failed = growParallel(&tree);
+	}
+	else cbonsaiGrowTree(&tree);
+
+	if (stats) *stats = tree.stats;
+	return (failed || target.full) ? -1 : 0;
+}
+
+/* growth in installments */
+
+void cbonsaiTipsInit(struct cbonsaiTips* tips, struct cbonsaiArena* arena) {
+	tips->arena = arena;
+	tips->first = NULL;
+	tips->last = NULL;
+	tips->unused = NULL;
+	tips->count = 0;
+	tips->full = 0;
+}
+
+int cbonsaiTipsAdd(struct cbonsaiTips* tips, const struct cbonsaiTip* tip) {
+	struct cbonsaiTip* added = tips->unused;
+	if (added) tips->unused = added->next;
+	else added = cbonsaiArenaAlloc(tips->arena, sizeof(*added));
+	if (!added) {
+		tips->full = 1;
+		return -1;
+	}
+
+	*added = *tip;
+	added->next = NULL;
+	if (tips->last) tips->last->next = added;
+	else tips->first = added;
+	tips->last = added;
+	tips->count++;
+	return 0;
+}
+
+// give a new branch its own stream and add it, taking what is left of the
+// installment of the branch it grew out of
+static int addTip(struct cbonsaiTree *tree, int y, int x, enum cbonsaiBranchType type, int life, int depth, uint64_t seed) {
+	struct cbonsaiTip tip;
+	startBranch(tree, &tip, type, y, x, life, depth);
+
+	uint64_t rng = tree->rng;
+	unsigned shootCounter = tree->shootCounter;
+	startStream(tree, seed);
+	tip.rng = tree->rng;
+	tip.shootCounter = tree->shootCounter;
+	tree->rng = rng;
+	tree->shootCounter = shootCounter;
+
+	tip.window = tree->tip ? tree->tip->window : 0;
+	return cbonsaiTipsAdd(tree->tips, &tip);
+}
+
+int cbonsaiTipsPlant(struct cbonsaiTree* tree, struct cbonsaiTips* tips) {
+	tree->branch = -1;
+	tree->tips = tips;
+	tree->tip = NULL;
+	int failed = addTip(tree, 0, 0, cbonsaiTrunk, tree->conf->lifeStart, 0, tree->conf->seed);
+	tree->tips = NULL;
+	return failed;
+}
+
+int cbonsaiGrowTips(struct cbonsaiTree* tree, struct cbonsaiTips* tips, int life, int steps) {
+	int start = tree->stats.steps;
+	tree->stopped = 0;
+	tree->tips = tips;
+	clock_gettime(CLOCK_MONOTONIC, &tree->startTime);
+
+	for (struct cbonsaiTip* tip = tips->first; tip; tip = tip->next)
+		tip->window = life;
+
+	// branches spawned along the way are added at the end, and grown in turn
+	struct cbonsaiTip* previous = NULL;
+	struct cbonsaiTip* tip = tips->first;
+	while (tip && !tree->stopped && (steps <= 0 || tree->stats.steps - start < steps)) {
+		tree->tip = tip;
+		tree->branch = tip->id;
+		tree->rng = tip->rng;
+		tree->shootCounter = tip->shootCounter;
+
+		while (tip->life > 0 && (life <= 0 || tip->window > 0) && (steps <= 0 || tree->stats.steps - start < steps)) {
+			tip->window--;
+			if (growStep(tree, tip) != 0) break;
+		}
+		tip->rng = tree->rng;
+		tip->shootCounter = tree->shootCounter;
+
+		// finished tips are kept for reuse
+		struct cbonsaiTip* next = tip->next;
+		if (tip->life <= 0) {
+			if (previous) previous->next = next;
+			else tips->first = next;
+			if (tips->last == tip) tips->last = previous;
+			tips->count--;
+			tip->next = tips->unused;
+			tips->unused = tip;
+		}
+		else previous = tip;
+		tip = next;
+	}
+
+	tree->tips = NULL;
+	tree->tip = NULL;
+	tree->branch = -1;
+	return tips->full ? -1 : 0;
+}
@@ -0,0 +1,181 @@
+// make check: grow trees one after another, through the library into the
+// same scene arena, and through the loop infinite mode runs on screen, and
+// check that once they have grown to fit the trees, growing them again takes
+// no memory from the heap. calls to malloc(), calloc() and realloc() made by
+// cbonsai and the library are counted by linking them with --wrap; curses
+// draws into a screen that is never refreshed, so no terminal is needed
+
+// cbonsai itself is built into the test, to drive its own loop. its main()
+// ends in quit(), which never returns, and is no longer main() here
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#define main cbonsaiMain
+#include "cbonsai.c"
+#undef main
+#pragma GCC diagnostic pop
+
+#define ROWS 60
+#define COLS 200
+#define SEEDS 200
+#define ROUNDS 5
+
+int heapCalls;
+int arenaBlocks;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+	heapCalls++;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+	heapCalls++;
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+	heapCalls++;
+	return __real_realloc(ptr, size);
+}
+
+void* growArena(size_t size) {
+	arenaBlocks++;
+	return __real_malloc(size);
+}
+
+// grow every seed once into the arena, writing each tree out like -p does.
+// returns nonzero if anything failed
+int growSeeds(struct cbonsaiArena* arena, struct cbonsaiCanvas* canvas, FILE* out) {
+	static const char* const leaves[] = {"&"};
+	struct cbonsaiConfig conf = {
+		.lifeStart = 32,
+		.multiplier = 5,
+		.leaves = leaves,
+		.leavesSize = 1,
+	};
+
+	for (unsigned long seed = 1; seed <= SEEDS; seed++) {
+		struct cbonsaiScene scene;
+		cbonsaiArenaReset(arena);
+		cbonsaiSceneInit(&scene, arena);
+
+		conf.seed = seed;
+		if (cbonsaiGrow(&conf, canvas, &scene, NULL) != 0) {
+			printf("error: seed %lu: the scene arena could not grow\n", seed);
+			return 1;
+		}
+		if (cbonsaiCanvasWriteAnsi(canvas, out) != 0) {
+			printf("error: seed %lu: could not write the tree\n", seed);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// grow every seed once the way the loop in main() does: grown on screen,
+// its leaves indexed for --ambient, then cleared away for the next tree
+void growScreenSeeds(struct config* conf, struct ncursesObjects* objects, struct scene* scene, struct counters* myCounters) {
+	for (int seed = 1; seed <= SEEDS; seed++) {
+		conf->seed = seed;
+		growNext(conf, objects, scene, myCounters);
+		werase(objects->treeWin);
+	}
+}
+
+// returns nonzero if growing trees on screen took memory after warm-up
+int checkScreen(void) {
+	// curses takes the screen size from LINES and COLUMNS
+	setenv("LINES", "60", 1);
+	setenv("COLUMNS", "200", 1);
+	setenv("TERM", "xterm", 0);
+	setlocale(LC_ALL, "");
+
+	FILE* out = fopen("/dev/null", "w");
+	FILE* in = fopen("/dev/null", "r");
+	if (!out || !in || !newterm(NULL, out, in)) {
+		printf("error: could not set up curses\n");
+		return 1;
+	}
+	start_color();
+
+	char leafList[] = "&";
+	struct config conf = {
+		.lifeStart = 32,
+		.multiplier = 5,
+		.baseType = 1,
+		.ambientFps = 5,
+		.timeWait = 4,
+		.timeStep = 0.03,
+		.leafList = leafList,
+	};
+	cbonsaiPaletteParse(&conf.palette, "classic");
+	if (loadLeaves(&conf) != 0) return 1;
+
+	struct ncursesObjects objects = {0};
+	initColors(&conf, &objects);
+	drawWins(conf.baseType, &objects);
+
+	struct scene scene = {0};
+	cbonsaiArenaInit(&scene.arena, NULL, 0);
+	scene.arena.grow = malloc;
+	struct counters myCounters = {0};
+	clock_gettime(CLOCK_MONOTONIC, &myCounters.runStart);
+
+	// warm up: the scene arena and the leaf index grow to fit the largest tree
+	growScreenSeeds(&conf, &objects, &scene, &myCounters);
+	int warmCalls = heapCalls;
+
+	for (int round = 0; round < ROUNDS; round++) {
+		growScreenSeeds(&conf, &objects, &scene, &myCounters);
+		if (heapCalls != warmCalls) {
+			printf("error: on screen, round %d after warm-up: %d new heap calls\n", round + 1, heapCalls - warmCalls);
+			return 1;
+		}
+	}
+
+	printf("alloc: %d trees on screen after warm-up, %zu leaves indexed, no new allocations\n", ROUNDS * SEEDS, scene.leaves.count);
+	delObjects(&objects);
+	endwin();
+	fclose(out);
+	fclose(in);
+	return 0;
+}
+
+int main(void) {
+	FILE* out = fopen("/dev/null", "w");
+	struct cbonsaiCell* cells = __real_malloc((size_t) ROWS * COLS * sizeof(*cells));
+	if (!out || !cells) {
+		printf("error: could not set up\n");
+		return 1;
+	}
+
+	struct cbonsaiCanvas canvas;
+	cbonsaiCanvasInit(&canvas, cells, ROWS, COLS);
+
+	struct cbonsaiArena arena;
+	cbonsaiArenaInit(&arena, NULL, 0);
+	arena.grow = growArena;
+
+	// warm up: the arena grows to fit the largest tree
+	if (growSeeds(&arena, &canvas, out) != 0) return 1;
+	int warmBlocks = arenaBlocks;
+	int warmCalls = heapCalls;
+
+	for (int round = 0; round < ROUNDS; round++) {
+		if (growSeeds(&arena, &canvas, out) != 0) return 1;
+		if (arenaBlocks != warmBlocks || heapCalls != warmCalls) {
+			printf("error: round %d after warm-up: %d new arena blocks, %d new heap calls\n", round + 1, arenaBlocks - warmBlocks, heapCalls - warmCalls);
+			return 1;
+		}
+	}
+
+	printf("alloc: %d trees after warm-up, %d arena blocks, no new allocations\n", ROUNDS * SEEDS, warmBlocks);
+	cbonsaiArenaRelease(&arena, free);
+	free(cells);
+	fclose(out);
+
+	return checkScreen();
+}
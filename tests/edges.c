@@ -0,0 +1,241 @@
+// make check: paint trees that run off the edges of the screen both onto a
+// canvas and into a curses window laid out like the tree window of cbonsai,
+// and check that the canvas shows what curses does. curses draws into a
+// screen that is never refreshed, so no terminal is needed.
+//
+// wide glyphs painted over each other are left out: curses keeps the halves
+// it overwrote, where the canvas blanks them, so only wide glyphs at the
+// edges are checked, with steps of their own
+
+#define _XOPEN_SOURCE_EXTENDED
+#include <limits.h>
+#include <locale.h>
+#include <ncurses.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "cbonsai.h"
+
+#define SEEDS 40
+
+// a screen size and the leaves to grow with
+struct layout {
+	int rows;
+	int cols;
+	int lifeStart;
+	int multiplier;
+	const char* const* leaves;
+	int leavesSize;
+};
+
+struct target {
+	WINDOW* win;
+	struct cbonsaiCanvas* canvas;
+};
+
+// paint a step like drawPaint() in cbonsai.c does, and onto the canvas
+void paintBoth(struct cbonsaiTree* tree, const struct cbonsaiPaint* paint) {
+	struct target* target = tree->userData;
+	int maxY, maxX;
+	getmaxyx(target->win, maxY, maxX);
+	int y = (maxY - 1) + paint->y;
+	int x = (maxX / 2) + paint->x;
+
+	wchar_t wc = 0;
+	mbstate_t state;
+	memset(&state, 0, sizeof(state));
+	mbrtowc(&wc, paint->str, MB_LEN_MAX, &state);
+	int width = wcwidth(wc);
+	if (!(width > 1 && x % width != 0))
+		mvwprintw(target->win, y, x, "%s", paint->str);
+
+	cbonsaiCanvasPaint(target->canvas, paint);
+}
+
+// a row of the window as text, like printstdscr() wrote it
+void windowRow(WINDOW* win, int y, char* out, size_t size) {
+	int maxX = getmaxx(win);
+	size_t len = 0;
+	out[0] = '\0';
+	for (int x = 0; x < maxX; x++) {
+		cchar_t c;
+		wchar_t wch[CCHARW_MAX + 1] = {0};
+		attr_t attrs;
+		short pair;
+		mvwin_wch(win, y, x, &c);
+		getcchar(&c, wch, &attrs, &pair, NULL);
+
+		char mb[64];
+		size_t n = wcstombs(mb, wch, sizeof(mb));
+		if (n == (size_t) -1 || len + n >= size) break;
+		memcpy(out + len, mb, n + 1);
+		len += n;
+
+		int width = wcswidth(wch, CCHARW_MAX);
+		if (width > 1) x += width - 1;
+	}
+}
+
+// a row of the canvas as text, blanks as spaces
+void canvasRow(const struct cbonsaiCanvas* canvas, int y, char* out, size_t size) {
+	const struct cbonsaiCell* row = &canvas->cells[(size_t) y * canvas->cols];
+	size_t len = 0;
+	out[0] = '\0';
+	for (int x = 0; x < canvas->cols; x++) {
+		if (!row[x].glyph[0] && row[x].width == 0 && x > 0 && row[x - 1].width == 2) continue;
+		const char* glyph = row[x].glyph[0] ? row[x].glyph : " ";
+		size_t n = strlen(glyph);
+		if (len + n >= size) break;
+		memcpy(out + len, glyph, n + 1);
+		len += n;
+	}
+}
+
+// compare the window with the canvas, whose rows below the window have to
+// be blank. returns nonzero if they differ
+int compareRows(WINDOW* win, const struct cbonsaiCanvas* canvas, const char* what) {
+	int treeRows = getmaxy(win);
+	char fromWindow[4096], fromCanvas[4096];
+
+	for (int y = 0; y < canvas->rows; y++) {
+		if (y < treeRows) windowRow(win, y, fromWindow, sizeof(fromWindow));
+		else {
+			memset(fromWindow, ' ', canvas->cols);
+			fromWindow[canvas->cols] = '\0';
+		}
+		canvasRow(canvas, y, fromCanvas, sizeof(fromCanvas));
+
+		if (strcmp(fromWindow, fromCanvas) != 0) {
+			printf("error: %dx%d, %s, row %d:\n  curses: |%s|\n  canvas: |%s|\n", canvas->cols, canvas->rows, what, y, fromWindow, fromCanvas);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// grow every seed on a screen of the layout. returns the number of trees
+// that came out differently
+int compareLayout(const struct layout* layout) {
+	// the tree window ends above a base of 4 rows, like base 1
+	int treeRows = layout->rows - 4;
+	WINDOW* win = newwin(treeRows, layout->cols, 0, 0);
+	struct cbonsaiCell* cells = malloc((size_t) layout->rows * layout->cols * sizeof(*cells));
+	if (!win || !cells) {
+		printf("error: could not set up a %dx%d screen\n", layout->cols, layout->rows);
+		return 1;
+	}
+
+	struct cbonsaiCanvas canvas;
+	cbonsaiCanvasInit(&canvas, cells, layout->rows, layout->cols);
+	canvas.anchorY = treeRows - 1;
+
+	struct target target = { win, &canvas };
+	struct cbonsaiConfig conf = {
+		.lifeStart = layout->lifeStart,
+		.multiplier = layout->multiplier,
+		.leaves = layout->leaves,
+		.leavesSize = layout->leavesSize,
+	};
+
+	int failed = 0;
+	for (unsigned long seed = 1; seed <= SEEDS; seed++) {
+		werase(win);
+		cbonsaiCanvasClear(&canvas);
+
+		struct cbonsaiTree tree;
+		memset(&tree, 0, sizeof(tree));
+		conf.seed = seed;
+		tree.conf = &conf;
+		tree.onPaint = paintBoth;
+		tree.userData = &target;
+		cbonsaiGrowTree(&tree);
+
+		char what[32];
+		snprintf(what, sizeof(what), "seed %lu", seed);
+		failed += compareRows(win, &canvas, what);
+	}
+
+	free(cells);
+	delwin(win);
+	return failed;
+}
+
+// paint steps with wide glyphs across the right edge and the last row of a
+// small window, one at a time. returns the number that came out differently
+int compareWideSteps(void) {
+	static const char* const steps[] = {"\xf0\x9f\x8c\xb8", "&\xf0\x9f\x8c\xb8", "&\xf0\x9f\x8c\xb8&", "&&\xf0\x9f\x8c\xb8&&"};
+	const int rows = 4, cols = 7;
+	WINDOW* win = newwin(rows - 1, cols, 0, 0);
+	struct cbonsaiCell cells[4 * 7];
+	struct cbonsaiCanvas canvas;
+	cbonsaiCanvasInit(&canvas, cells, rows, cols);
+	canvas.anchorY = rows - 2;
+
+	struct cbonsaiTree tree;
+	memset(&tree, 0, sizeof(tree));
+	struct target target = { win, &canvas };
+	tree.userData = &target;
+
+	int failed = 0;
+	for (size_t i = 0; i < sizeof(steps) / sizeof(*steps); i++) {
+		for (int y = -rows; y <= 1; y++) {
+			for (int x = -cols; x <= cols; x += 2) {
+				werase(win);
+				cbonsaiCanvasClear(&canvas);
+
+				struct cbonsaiPaint paint = { .y = y, .x = x, .str = steps[i], .type = cbonsaiDead };
+				paintBoth(&tree, &paint);
+
+				char what[48];
+				snprintf(what, sizeof(what), "step %zu at %d,%d", i, y, x);
+				failed += compareRows(win, &canvas, what);
+			}
+		}
+	}
+
+	delwin(win);
+	return failed;
+}
+
+int main(void) {
+	// curses takes the screen size from LINES and COLUMNS
+	setenv("LINES", "60", 1);
+	setenv("COLUMNS", "200", 1);
+	setenv("TERM", "xterm", 0);
+	int wide = setlocale(LC_ALL, "C.UTF-8") != NULL;
+
+	FILE* out = fopen("/dev/null", "w");
+	FILE* in = fopen("/dev/null", "r");
+	if (!out || !in || !newterm(NULL, out, in)) {
+		printf("error: could not set up curses\n");
+		return 1;
+	}
+
+	static const char* const plain[] = {"&"};
+	static const char* const several[] = {"&&&", "&"};
+	const struct layout layouts[] = {
+		{ 30, 50, 80, 6, plain, 1 },
+		{ 24, 80, 60, 8, plain, 1 },
+		{ 20, 41, 50, 5, several, 2 },
+	};
+
+	int failed = 0, trees = 0;
+	for (size_t i = 0; i < sizeof(layouts) / sizeof(*layouts); i++) {
+		failed += compareLayout(&layouts[i]);
+		trees += SEEDS;
+	}
+	if (wide) failed += compareWideSteps();
+
+	endwin();
+	fclose(out);
+	fclose(in);
+
+	if (failed) {
+		printf("edges: %d trees or steps differ from curses\n", failed);
+		return 1;
+	}
+	printf("edges: %d trees%s painted as curses paints them\n", trees, wide ? " and wide steps" : "");
+	return 0;
+}